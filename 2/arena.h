@@ -0,0 +1,193 @@
+/* Pula pamięci dla węzłów struktur jednego słownika */
+#ifndef arena_h
+#define arena_h
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <vector>
+#include <sys/mman.h>
+
+/* Przydziela małe bloki z dużych obszarów zmapowanych w całości
+ * (mmap), zamiast osobnego malloc dla każdego węzła. Bloki są
+ * zaokrąglane do wielokrotności ALIGN, a zwolnione trafiają na listę
+ * wolnych bloków swojego rozmiaru i są ponownie używane. Obszary są
+ * zwracane systemowi razem, przy zniszczeniu puli.
+ * Kolejne obszary są dwa razy większe od poprzednich, do HUGE_SIZE;
+ * obszary tej wielkości są wyrównane do niej i mogą być oznaczone jako
+ * strony olbrzymie (MADV_HUGEPAGE), więc mały słownik nie zajmuje całej
+ * strony olbrzymiej, a duży nie płaci za chybienia TLB.
+ * Z puli przydziela naraz tylko jeden wątek - piszący słownika - więc
+ * przydział nie wymaga blokady. Blok może zostać zwolniony przez dowolny
+ * wątek, który puścił ostatnią wersję słownika z tym blokiem, dlatego
+ * zwolnione bloki trafiają na listę zwrotów swojego rozmiaru, dołączane
+ * jedną operacją compare_exchange. Przydzielający przejmuje całą listę
+ * zwrotów naraz, gdy wyczerpie własną listę wolnych bloków, więc nie
+ * grozi mu problem ABA.
+ * Kopia słownika przydziela nowe węzły z własnej puli, ale współdzieli
+ * węzły oryginału, więc jej pula trzyma pulę oryginału (parent). */
+class Arena {
+public:
+  explicit Arena(bool hugepages, std::shared_ptr<Arena> parent = nullptr)
+    : hugepages(hugepages), next_size(FIRST_SIZE), current(nullptr),
+      end(nullptr), free_lists(), bytes(0), up(std::move(parent)) {
+    for (auto &list : returned)
+      list.store(nullptr, std::memory_order_relaxed);
+  }
+
+  Arena(Arena const &) = delete;
+  Arena& operator=(Arena const &) = delete;
+
+  ~Arena() {
+    for (auto const &c : chunks)
+      munmap(c.first, c.second);
+  }
+
+  /* Wywoływana tylko przez piszącego */
+  void* allocate(size_t size) {
+    if (size > MAX_BLOCK) {
+      bytes.fetch_add(size, std::memory_order_relaxed);
+      return ::operator new(size);
+    }
+    size_t cls = size_class(size);
+    FreeBlock *block = free_lists[cls];
+    if (block == nullptr &&
+        returned[cls].load(std::memory_order_relaxed) != nullptr)
+      block = returned[cls].exchange(nullptr, std::memory_order_acquire);
+    if (block != nullptr) {
+      free_lists[cls] = block->next;
+      return block;
+    }
+    size_t need = (cls + 1) * ALIGN;
+    if (static_cast<size_t>(end - current) < need)
+      grow();
+    void *p = current;
+    current += need;
+    return p;
+  }
+
+  /* Może być wywoływana przez dowolny wątek */
+  void deallocate(void *p, size_t size) {
+    if (size > MAX_BLOCK) {
+      bytes.fetch_sub(size, std::memory_order_relaxed);
+      ::operator delete(p);
+      return;
+    }
+    FreeBlock *block = static_cast<FreeBlock *>(p);
+    std::atomic<FreeBlock *> &list = returned[size_class(size)];
+    block->next = list.load(std::memory_order_relaxed);
+    while (!list.compare_exchange_weak(block->next, block,
+                                       std::memory_order_release,
+                                       std::memory_order_relaxed)) {}
+  }
+
+  /* Liczba bajtów zmapowanych przez pulę i przydzielonych przez nią
+   * poza obszarami, bez puli parent */
+  size_t reserved() const {
+    return bytes.load(std::memory_order_relaxed);
+  }
+
+  /* Pula, której węzły mogą być współdzielone z węzłami tej puli */
+  std::shared_ptr<Arena> const& parent() const { return up; }
+
+private:
+  static const size_t ALIGN = 16;
+  static const size_t MAX_BLOCK = 512;
+  static const size_t FIRST_SIZE = 64 << 10;
+  static const size_t HUGE_SIZE = 2 << 20;
+
+  struct FreeBlock {
+    FreeBlock *next;
+  };
+
+  bool hugepages;
+  size_t next_size;
+  char *current;                     // wolna część ostatniego obszaru
+  char *end;
+  FreeBlock *free_lists[MAX_BLOCK / ALIGN];  // należą do przydzielającego
+  std::atomic<FreeBlock *> returned[MAX_BLOCK / ALIGN];
+  std::vector<std::pair<void *, size_t>> chunks;
+  std::atomic<size_t> bytes;
+  std::shared_ptr<Arena> up;
+
+  static size_t size_class(size_t size) {
+    return size == 0 ? 0 : (size - 1) / ALIGN;
+  }
+
+  /* Mapuje następny obszar. Reszta poprzedniego obszaru przepada, bo jest
+   * mniejsza od największego bloku */
+  void grow() {
+    size_t size = next_size;
+    size_t align = size >= HUGE_SIZE ? HUGE_SIZE : 0;
+    void *addr = mmap(nullptr, size + align, PROT_READ | PROT_WRITE,
+                      MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (addr == MAP_FAILED)
+      throw std::bad_alloc();
+    if (align > 0) {                 // przycina do wyrównanego obszaru
+      uintptr_t start = reinterpret_cast<uintptr_t>(addr);
+      uintptr_t aligned = (start + align - 1) & ~(align - 1);
+      if (aligned > start)
+        munmap(addr, aligned - start);
+      if (start + align > aligned)
+        munmap(reinterpret_cast<void *>(aligned + size),
+               start + align - aligned);
+      addr = reinterpret_cast<void *>(aligned);
+#ifdef MADV_HUGEPAGE
+      if (hugepages)
+        madvise(addr, size, MADV_HUGEPAGE);
+#endif
+    }
+    chunks.emplace_back(addr, size);
+    bytes.fetch_add(size, std::memory_order_relaxed);
+    current = static_cast<char *>(addr);
+    end = current + size;
+    if (next_size < HUGE_SIZE)
+      next_size *= 2;
+  }
+};
+
+/* Alokator przydzielający z puli, a bez niej z operator new; do użycia
+ * z std::allocate_shared i z kontenerami w węzłach. Nie przedłuża życia
+ * puli - pula musi istnieć dłużej niż przydzielone z niej bloki */
+template <typename T>
+class ArenaAllocator {
+public:
+  using value_type = T;
+
+  explicit ArenaAllocator(Arena *arena) : arena(arena) {}
+
+  template <typename U>
+  ArenaAllocator(ArenaAllocator<U> const &other) : arena(other.arena) {}
+
+  T* allocate(size_t n) {
+    size_t size = n * sizeof(T);
+    void *p = arena ? arena->allocate(size) : ::operator new(size);
+    return static_cast<T *>(p);
+  }
+
+  void deallocate(T *p, size_t n) {
+    if (arena)
+      arena->deallocate(p, n * sizeof(T));
+    else
+      ::operator delete(p);
+  }
+
+  template <typename U>
+  bool operator==(ArenaAllocator<U> const &other) const {
+    return arena == other.arena;
+  }
+
+  template <typename U>
+  bool operator!=(ArenaAllocator<U> const &other) const {
+    return arena != other.arena;
+  }
+
+private:
+  template <typename U> friend class ArenaAllocator;
+
+  Arena *arena;
+};
+
+#endif
@@ -0,0 +1,353 @@
+/* Trwałe skompresowane drzewo cyfr (radix trie) ze zmianami numerów
+ * i zmianami prefiksów */
+#ifndef digit_trie_h
+#define digit_trie_h
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <utility>
+#include <vector>
+#include "arena.h"
+#include "edit_token.h"
+#include "number.h"
+
+/* Każdy węzeł odpowiada ciągowi cyfr ze ścieżki od korzenia i może mieć
+ * przypisaną zmianę dokładnie tego numeru oraz zmianę wszystkich numerów
+ * zaczynających się od tego ciągu. Krawędzie bez rozgałęzień są
+ * łączone w jedną etykietę, więc wspólne prefiksy numerów zapisane są
+ * raz. Kopie współdzielą węzły tak jak w PersistentMap: zmiana kopiuje
+ * węzły na ścieżce od korzenia bez znacznika edycji tego drzewa, a węzły
+ * wraz z tablicami dzieci przydziela z puli przekazanej w konstruktorze.
+ * Etykiety i zmiany są zapisane w samych węzłach (Number). */
+class DigitTrie {
+public:
+  /* Wynik wyszukiwania numeru */
+  struct Match {
+    Number const *number = nullptr;  // zmiana dokładnie tego numeru
+    Number const *prefix = nullptr;  // najdłuższa pasująca zmiana
+    size_t prefix_len = 0;           // długość prefiksu tej zmiany
+  };
+
+  explicit DigitTrie(std::shared_ptr<Arena> arena = nullptr)
+    : pool(std::move(arena)), root(), numbers(0), prefixes(0),
+      edit(new_edit_token()) {}
+
+  /* Tak jak konstruktory kopiujące PersistentMap */
+  DigitTrie(DigitTrie const &other)
+    : pool(other.pool), root(other.root), numbers(other.numbers),
+      prefixes(other.prefixes), edit(new_edit_token()) {
+    other.edit.store(new_edit_token(), std::memory_order_relaxed);
+  }
+
+  /* Tak jak PersistentMap(other, arena) */
+  DigitTrie(DigitTrie const &other, std::shared_ptr<Arena> arena)
+    : pool(std::move(arena)), root(other.root), numbers(other.numbers),
+      prefixes(other.prefixes), edit(new_edit_token()) {
+    other.edit.store(new_edit_token(), std::memory_order_relaxed);
+  }
+
+  DigitTrie(DigitTrie &&other)
+    : pool(std::move(other.pool)), root(std::move(other.root)),
+      numbers(other.numbers), prefixes(other.prefixes),
+      edit(other.edit.load(std::memory_order_relaxed)) {
+    other.numbers = other.prefixes = 0;
+    other.edit.store(new_edit_token(), std::memory_order_relaxed);
+  }
+
+  /* Tak jak PersistentMap::operator= */
+  DigitTrie& operator=(DigitTrie other) {
+    std::swap(pool, other.pool);
+    std::swap(root, other.root);
+    std::swap(numbers, other.numbers);
+    std::swap(prefixes, other.prefixes);
+    uint64_t token = edit.load(std::memory_order_relaxed);
+    edit.store(other.edit.load(std::memory_order_relaxed),
+               std::memory_order_relaxed);
+    other.edit.store(token, std::memory_order_relaxed);
+    return *this;
+  }
+
+  size_t number_count() const { return numbers; }
+  size_t prefix_count() const { return prefixes; }
+  bool empty() const { return numbers == 0 && prefixes == 0; }
+
+  /* Szuka zmiany numeru key oraz najdłuższej zmiany jego prefiksu,
+   * jednym przejściem od korzenia */
+  Match match(Number const &key) const {
+    Match m;
+    Node const *node = root.get();
+    size_t depth = 0;
+    while (node != nullptr) {
+      if (node->has_prefix && depth > 0) {
+        m.prefix = &node->prefix;
+        m.prefix_len = depth;
+      }
+      if (depth == key.size()) {
+        if (node->has_number)
+          m.number = &node->number;
+        break;
+      }
+      Node const *child = node->child(key[depth]);
+      if (child == nullptr || !key.has_at(depth, child->label))
+        break;
+      depth += child->label.size();
+      node = child;
+    }
+    return m;
+  }
+
+  Number const* find_number(Number const &key) const {
+    return match(key).number;
+  }
+
+  void set_number(Number const &key, Number const &value) {
+    if (set(key, NUMBER, value))
+      ++numbers;
+  }
+
+  void set_prefix(Number const &key, Number const &value) {
+    if (set(key, PREFIX, value))
+      ++prefixes;
+  }
+
+  /* Usuwa zmianę numeru key, zwraca false, jeśli jej nie było */
+  bool erase_number(Number const &key) {
+    if (!erase(key, NUMBER))
+      return false;
+    --numbers;
+    return true;
+  }
+
+  /* Usuwa zmianę prefiksu key, zwraca false, jeśli jej nie było */
+  bool erase_prefix(Number const &key) {
+    if (!erase(key, PREFIX))
+      return false;
+    --prefixes;
+    return true;
+  }
+
+  /* Wywołuje f(numer, zmiana) dla każdej zmiany numeru */
+  template <typename F>
+  void for_each_number(F f) const {
+    Number key;
+    for_each(root.get(), key, NUMBER, f);
+  }
+
+  /* Wywołuje f(prefiks, zmiana) dla każdej zmiany prefiksu */
+  template <typename F>
+  void for_each_prefix(F f) const {
+    Number key;
+    for_each(root.get(), key, PREFIX, f);
+  }
+
+  /* Przebudowuje węzły, tak jak PersistentMap::compact */
+  void compact() {
+    root = compact(root.get());
+  }
+
+private:
+  enum Field { NUMBER, PREFIX };
+
+  struct Node;
+  using NodePtr = std::shared_ptr<Node>;
+
+  /* Etykieta to cyfry krawędzi prowadzącej do węzła, jej pierwsza cyfra
+   * wyznacza pozycję węzła wśród dzieci rodzica. Dzieci są zapisane
+   * zwięźle, w kolejności cyfr ustawionych w mask */
+  struct Node {
+    Number label;
+    uint64_t edit = 0;               // znacznik drzewa, które go utworzyło
+    uint16_t mask = 0;
+    bool has_number = false;
+    bool has_prefix = false;
+    Number number;
+    Number prefix;
+    std::vector<NodePtr, ArenaAllocator<NodePtr>> children;
+
+    explicit Node(Arena *arena) : children(ArenaAllocator<NodePtr>(arena)) {}
+
+    /* Tak jak PersistentMap::Node(other, arena) */
+    Node(Node const &other, Arena *arena)
+      : label(other.label), edit(other.edit), mask(other.mask),
+        has_number(other.has_number), has_prefix(other.has_prefix),
+        number(other.number), prefix(other.prefix),
+        children(other.children, ArenaAllocator<NodePtr>(arena)) {}
+
+    static uint16_t bit(char digit) {
+      return static_cast<uint16_t>(1) << (digit - '0');
+    }
+
+    size_t position(char digit) const {
+      return __builtin_popcount(mask & (bit(digit) - 1));
+    }
+
+    Node const* child(char digit) const {
+      if ((mask & bit(digit)) == 0)
+        return nullptr;
+      return children[position(digit)].get();
+    }
+
+    bool has(Field field) const {
+      return field == NUMBER ? has_number : has_prefix;
+    }
+
+    void assign(Field field, bool present, Number const &value) {
+      (field == NUMBER ? has_number : has_prefix) = present;
+      (field == NUMBER ? number : prefix) = value;
+    }
+  };
+
+  std::shared_ptr<Arena> pool;       // niszczona po root
+  NodePtr root;                      // etykieta korzenia jest pusta
+  size_t numbers;
+  size_t prefixes;
+  mutable std::atomic<uint64_t> edit; // tak jak w PersistentMap
+
+  ArenaAllocator<Node> alloc() const {
+    return ArenaAllocator<Node>(pool.get());
+  }
+
+  /* Zwraca węzeł, który wolno zmieniać w miejscu: sam node, jeśli ma
+   * znacznik tego drzewa, a w przeciwnym razie jego kopię */
+  NodePtr own(NodePtr const &node) const {
+    uint64_t token = edit.load(std::memory_order_relaxed);
+    if (node->edit == token)
+      return node;
+    NodePtr copy = std::allocate_shared<Node>(alloc(), *node, pool.get());
+    copy->edit = token;
+    return copy;
+  }
+
+  NodePtr make_node(Number const &label) const {
+    NodePtr node = std::allocate_shared<Node>(alloc(), pool.get());
+    node->label = label;
+    node->edit = edit.load(std::memory_order_relaxed);
+    return node;
+  }
+
+  static void add_child(Node &parent, NodePtr child) {
+    char digit = child->label[0];
+    parent.children.insert(parent.children.begin() + parent.position(digit),
+                           std::move(child));
+    parent.mask |= Node::bit(digit);
+  }
+
+  /* Ustawia pole field węzła key, zwraca true, jeśli było puste */
+  bool set(Number const &key, Field field, Number const &value) {
+    if (!root)
+      root = make_node(Number());
+    root = own(root);
+    Node *node = root.get();
+    size_t depth = 0;
+    while (depth < key.size()) {
+      char digit = key[depth];
+      if ((node->mask & Node::bit(digit)) == 0) {
+        NodePtr leaf = make_node(key.substr(depth, key.size() - depth));
+        leaf->assign(field, true, value);
+        add_child(*node, std::move(leaf));
+        return true;
+      }
+
+      NodePtr &slot = node->children[node->position(digit)];
+      slot = own(slot);
+      Number const &label = slot->label;
+      size_t common = 0;
+      while (common < label.size() && depth + common < key.size() &&
+             label[common] == key[depth + common])
+        ++common;
+
+      if (common < label.size()) {   // podział krawędzi
+        NodePtr middle = make_node(label.substr(0, common));
+        slot->label.erase_front(common);
+        add_child(*middle, std::move(slot));
+        slot = std::move(middle);
+      }
+      node = slot.get();
+      depth += common;
+    }
+    bool added = !node->has(field);
+    node->assign(field, true, value);
+    return added;
+  }
+
+  bool erase(Number const &key, Field field) {
+    if (!contains(key, field))
+      return false;
+    root = erase(root, key, 0, field);
+    return true;
+  }
+
+  bool contains(Number const &key, Field field) const {
+    Node const *node = root.get();
+    size_t depth = 0;
+    while (node != nullptr && depth < key.size()) {
+      Node const *child = node->child(key[depth]);
+      if (child == nullptr || !key.has_at(depth, child->label))
+        return false;
+      depth += child->label.size();
+      node = child;
+    }
+    return node != nullptr && depth == key.size() && node->has(field);
+  }
+
+  /* Usuwa pole field węzła key, które na pewno jest ustawione, i łączy
+   * węzeł bez zmian i z jednym dzieckiem z tym dzieckiem */
+  NodePtr erase(NodePtr const &node, Number const &key,
+                size_t depth, Field field) const {
+    NodePtr result = own(node);
+    if (depth == key.size()) {
+      result->assign(field, false, Number());
+    } else {
+      size_t pos = result->position(key[depth]);
+      NodePtr &slot = result->children[pos];
+      NodePtr child = erase(slot, key, depth + slot->label.size(), field);
+      if (child) {
+        slot = std::move(child);
+      } else {
+        result->children.erase(result->children.begin() + pos);
+        result->mask &= ~Node::bit(key[depth]);
+      }
+    }
+
+    if (result->has_number || result->has_prefix)
+      return result;
+    if (result->children.empty())
+      return nullptr;
+    if (result->children.size() == 1 && depth > 0) {
+      NodePtr merged = own(result->children[0]);
+      merged->label.prepend(result->label);
+      return merged;
+    }
+    return result;
+  }
+
+  NodePtr compact(Node const *node) const {
+    if (node == nullptr)
+      return nullptr;
+    NodePtr result = make_node(node->label);
+    result->mask = node->mask;
+    result->has_number = node->has_number;
+    result->has_prefix = node->has_prefix;
+    result->number = node->number;
+    result->prefix = node->prefix;
+    result->children.reserve(node->children.size());
+    for (auto const &child : node->children)
+      result->children.push_back(compact(child.get()));
+    return result;
+  }
+
+  template <typename F>
+  static void for_each(Node const *node, Number &key, Field field, F &f) {
+    if (node == nullptr)
+      return;
+    key.append(node->label);
+    if (node->has(field))
+      f(key, field == NUMBER ? node->number : node->prefix);
+    for (auto const &child : node->children)
+      for_each(child.get(), key, field, f);
+    key.truncate(key.size() - node->label.size());
+  }
+};
+
+#endif
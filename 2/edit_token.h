@@ -0,0 +1,21 @@
+/* Znaczniki edycji węzłów trwałych struktur */
+#ifndef edit_token_h
+#define edit_token_h
+
+#include <atomic>
+#include <cstdint>
+
+/* Tak jak w przejściowych (transient) kolekcjach Clojure, każda kopia
+ * trwałej struktury ma własny znacznik edycji, a każdy węzeł pamięta
+ * znacznik struktury, która go utworzyła. Struktura zmienia w miejscu
+ * tylko węzły ze swoim znacznikiem, a pozostałe najpierw kopiuje.
+ * Skopiowanie struktury daje nowe znaczniki i kopii, i oryginałowi, więc
+ * węzły utworzone przed skopiowaniem nie są już zmieniane przez żadną
+ * z nich, niezależnie od tego, kto jeszcze trzyma do nich wskaźniki.
+ * Zwraca znacznik różny od wszystkich poprzednich i od 0. */
+inline uint64_t new_edit_token() {
+  static std::atomic<uint64_t> last(0);
+  return last.fetch_add(1, std::memory_order_relaxed) + 1;
+}
+
+#endif
@@ -0,0 +1,69 @@
+/* Szacowanie pamięci zajmowanej przez struktury słowników */
+#ifndef heap_usage_h
+#define heap_usage_h
+
+#include <cstddef>
+#include <functional>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+/* Narzut bloku przydzielonego przez std::make_shared: blok kontrolny
+ * z dwoma licznikami i wskaźnikiem tablicy funkcji wirtualnych */
+const size_t SHARED_BLOCK_OVERHEAD = 2 * sizeof(long) + sizeof(void *);
+
+/* Narzut węzła kontenera haszującego: wskaźnik następnika i hasz */
+const size_t HASH_NODE_OVERHEAD = sizeof(void *) + sizeof(size_t);
+
+/* Bajty przydzielone na stercie przez obiekt, nie licząc samego obiektu */
+template <typename T>
+inline size_t heap_bytes(T const &) {
+  return 0;
+}
+
+/* Krótki napis mieści się w samym obiekcie i nie zajmuje sterty */
+inline size_t heap_bytes(std::string const &s) {
+  char const *self = reinterpret_cast<char const *>(&s);
+  std::less<char const *> before;
+  if (!before(s.data(), self) && before(s.data(), self + sizeof(s)))
+    return 0;
+  return s.capacity() + 1;
+}
+
+/* Przeciążenia dla kontenerów muszą być zadeklarowane przed użyciem
+ * w szablonach, bo wyszukiwanie zależne od argumentów nie zagląda
+ * do globalnej przestrzeni nazw */
+template <typename A, typename B>
+inline size_t heap_bytes(std::pair<A, B> const &p) {
+  return heap_bytes(p.first) + heap_bytes(p.second);
+}
+
+template <typename T>
+inline size_t heap_bytes(std::vector<T> const &v) {
+  size_t bytes = v.capacity() * sizeof(T);
+  for (T const &e : v)
+    bytes += heap_bytes(e);
+  return bytes;
+}
+
+template <typename T>
+inline size_t heap_bytes(std::unordered_set<T> const &s) {
+  size_t bytes = s.bucket_count() * sizeof(void *) +
+                 s.size() * (sizeof(T) + HASH_NODE_OVERHEAD);
+  for (T const &e : s)
+    bytes += heap_bytes(e);
+  return bytes;
+}
+
+template <typename K, typename V>
+inline size_t heap_bytes(std::unordered_map<K, V> const &m) {
+  size_t bytes = m.bucket_count() * sizeof(void *) +
+                 m.size() * (sizeof(std::pair<K const, V>) +
+                             HASH_NODE_OVERHEAD);
+  for (auto const &e : m)
+    bytes += heap_bytes(e.first) + heap_bytes(e.second);
+  return bytes;
+}
+
+#endif
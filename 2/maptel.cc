@@ -7,169 +7,1855 @@
 #include <string>
 #include <cstring>
 #include <cctype>
+#include <cstdint>
+#ifdef __SSE2__
+  #include <emmintrin.h>
+#endif
 #include <sstream>
 #include <unordered_map>
-#include <set>
+#include <unordered_set>
+#include <vector>
+#include <memory>
+#include <algorithm>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <condition_variable>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "persistent_map.h"
+#include "digit_trie.h"
+#include "arena.h"
+#include "heap_usage.h"
+#include "number.h"
 
-#define MAX_U_LONG_INT 4294967295
+/* Śledzenie operacji, domyślnie włączone w wersji diagnostycznej */
+#ifndef MAPTEL_TRACE
+  #ifndef NDEBUG
+    #define MAPTEL_TRACE 1
+  #else
+    #define MAPTEL_TRACE 0
+  #endif
+#endif
+
+/* Czy duże obszary puli węzłów słownika mają być stronami olbrzymimi */
+#ifndef MAPTEL_HUGEPAGES
+  #define MAPTEL_HUGEPAGES 1
+#endif
 
 using namespace std;
-using MAPTEL = unordered_map<string, string>;
+using MAPTEL = PersistentMap<Number, Number>;
 
 namespace {
-  /* Zmienna do wypisywania informacji diagnostycznych */
-  #ifndef NDEBUG
-    const bool debug = true;
-  #else
-    const bool debug = false;
-  #endif
+  /* Zmienna do zgłaszania zdarzeń śledzenia, przy wartości false
+   * kompilator usuwa je w całości */
+  const bool tracing = MAPTEL_TRACE;
+
+  /* Zarejestrowana funkcja śledząca, NULL oznacza wypisywanie na cerr */
+  atomic<maptel_trace_fn>& trace_fn() {
+    static atomic<maptel_trace_fn> fn(NULL);
+    return fn;
+  }
+
+  /* Wypisuje zdarzenie na standardowe wyjście błędów, jednym zapisem,
+   * aby wiersze zdarzeń z różnych wątków się nie przeplatały */
+  void print_trace(maptel_trace_event const &e) {
+    ostringstream out;
+    switch (e.kind) {
+    case MAPTEL_TRACE_CREATE:
+      out << "maptel: maptel_create()\n"
+          << "maptel: maptel_create: new map id = " << e.id << "\n";
+      break;
+    case MAPTEL_TRACE_DELETE:
+      out << "maptel: maptel_delete(" << e.id << ")\n"
+          << "maptel: maptel_delete: map " << e.id << " deleted\n";
+      break;
+    case MAPTEL_TRACE_INSERT:
+      out << "maptel: maptel_insert(" << e.id << ", "
+          << e.tel_src << ", " << e.tel_dst << ")\n"
+          << "maptel: maptel_insert: inserted\n";
+      break;
+    case MAPTEL_TRACE_ERASE:
+      out << "maptel: maptel_erase(" << e.id << ", " << e.tel_src << ")\n"
+          << "maptel: maptel_erase: "
+          << (e.result ? "erased\n" : "nothing to erase\n");
+      break;
+    case MAPTEL_TRACE_TRANSFORM:
+      out << "maptel: maptel_transform(" << e.id << ", " << e.tel_src
+          << ", " << static_cast<void const *>(e.tel_dst) << ", "
+          << e.count << ")\n";
+      if (e.result == 1)
+        out << "maptel: maptel_transform: cycle detected\n";
+      else if (e.result == 2)
+        out << "maptel: maptel_transform: hop limit reached\n";
+      out << "maptel: maptel_transform: "
+          << e.tel_src << " -> " << e.tel_dst << ", \n";
+      break;
+    case MAPTEL_TRACE_INSERT_PREFIX:
+      out << "maptel: maptel_insert_prefix(" << e.id << ", "
+          << e.tel_src << ", " << e.tel_dst << ")\n"
+          << "maptel: maptel_insert_prefix: inserted\n";
+      break;
+    case MAPTEL_TRACE_ERASE_PREFIX:
+      out << "maptel: maptel_erase_prefix(" << e.id << ", "
+          << e.tel_src << ")\n"
+          << "maptel: maptel_erase_prefix: "
+          << (e.result ? "erased\n" : "nothing to erase\n");
+      break;
+    case MAPTEL_TRACE_OVERLAY_CREATE:
+      out << "maptel: maptel_overlay_create(" << e.count << " layers)\n"
+          << "maptel: maptel_overlay_create: new overlay id = " << e.id
+          << "\n";
+      break;
+    case MAPTEL_TRACE_OVERLAY_DELETE:
+      out << "maptel: maptel_overlay_delete(" << e.id << ")\n";
+      break;
+    case MAPTEL_TRACE_OVERLAY_TRANSFORM:
+      out << "maptel: maptel_overlay_transform(" << e.id << ", "
+          << e.tel_src << ", " << static_cast<void const *>(e.tel_dst)
+          << ", " << e.count << ")\n";
+      if (e.result)
+        out << "maptel: maptel_overlay_transform: hop limit reached\n";
+      out << "maptel: maptel_overlay_transform: "
+          << e.tel_src << " -> " << e.tel_dst << "\n";
+      break;
+    case MAPTEL_TRACE_CLONE:
+      out << "maptel: maptel_clone(" << e.id << ")\n"
+          << "maptel: maptel_clone: new map id = " << e.count << "\n";
+      break;
+    case MAPTEL_TRACE_COMPACT:
+      out << "maptel: maptel_compact(" << e.id << ")\n"
+          << "maptel: maptel_compact: " << e.count << " bytes in use\n";
+      break;
+    case MAPTEL_TRACE_SAVE:
+      out << "maptel: maptel_save(" << e.id << ", " << e.path << ")\n"
+          << "maptel: maptel_save: "
+          << (e.result == 0 ? "saved " : "failed to save ") << e.count
+          << " entries\n";
+      break;
+    case MAPTEL_TRACE_LOAD:
+      out << "maptel: maptel_load(" << e.path << ")\n";
+      if (e.result == 0)
+        out << "maptel: maptel_load: loaded into map " << e.id << "\n";
+      else
+        out << "maptel: maptel_load: invalid image\n";
+      break;
+    case MAPTEL_TRACE_LOAD_FILE:
+      out << "maptel: maptel_load_file(" << e.id << ", " << e.path << ")\n"
+          << "maptel: maptel_load_file: "
+          << (e.result == 0 ? "loaded " : "failed, loaded ") << e.count
+          << " entries\n";
+      break;
+    }
+    cerr << out.str();
+  }
+
+  /* Zgłasza zdarzenie zarejestrowanej funkcji śledzącej */
+  void trace(maptel_trace_kind kind, unsigned long id,
+             char const *tel_src = NULL, char const *tel_dst = NULL,
+             char const *path = NULL, size_t count = 0, int result = 0) {
+    maptel_trace_event e = {kind, id, tel_src, tel_dst, path, count, result};
+    maptel_trace_fn fn = trace_fn().load(memory_order_acquire);
+    if (fn != NULL)
+      fn(&e);
+    else
+      print_trace(e);
+  }
   
-  /* Tworzy mape map służąca do trzymania wielu słowników
-   * W wewnętrznej mapie pod kluczem - numer trzymana jest ewentualna
-   * jego zmiana - przekierowanie */
-  unordered_map<unsigned long, MAPTEL>& dicts() {
-    static unordered_map<unsigned long, MAPTEL> map;
-    return map;
-  }
-
-  /* Podąża ciągiem kolejnych zmian, aby znaleźć końcowy numer
-   * jeśli znajdzie końcowy numer zwraca go
-   * jeśli nie ma zmiany zwraca początkowego stringa
-   * jeśli zmiany prowadzą do cyklu zwraca empty string o długości 0 
-   * do szukania powtórzeń wykorzystuje set, 
-   * zapisuje w nim numery, które już wystąpiły*/
-  string find_dst(MAPTEL& m, string& s_src) {
-    set<string> repeated;
-    string s (s_src);
-    MAPTEL::iterator it;
-
-    while ((it = m.find(s)) != m.end()) {
-      if (repeated.count(s) > 0) {
-        return "\0";
-      }
-      repeated.insert(s);
-      s = it->second;
-    }
-    return s;
+  /* Nagłówek obrazu słownika zapisywanego przez maptel_save */
+  struct ImageHeader {
+    char magic[8];
+    uint64_t slot_count;             // potęga dwójki
+    uint64_t entry_count;
+    uint64_t prefix_count;           // zmiany prefiksów po tablicy
+  };
+
+  /* Pojedyncze pole tablicy haszującej z adresowaniem otwartym,
+   * pusty src oznacza wolne pole. Zmiany prefiksów zapisane są
+   * w tym samym formacie */
+  struct ImageSlot {
+    char src[TEL_NUM_MAX_LEN + 1];
+    char dst[TEL_NUM_MAX_LEN + 1];
+  };
+
+  const char IMAGE_MAGIC[8] = "MAPTEL2";
+
+  /* Funkcja haszująca FNV-1a, niezależna od implementacji biblioteki
+   * standardowej, aby obraz był czytelny dla innych procesów */
+  uint64_t image_hash(char const *s) {
+    uint64_t h = 14695981039346656037ULL;
+    for (; *s != '\0'; ++s) {
+      h ^= static_cast<unsigned char>(*s);
+      h *= 1099511628211ULL;
+    }
+    return h;
+  }
+
+  /* Obraz słownika zmapowany do pamięci tylko do odczytu */
+  class Image {
+  public:
+    Image(void *addr, size_t size) : addr(addr), size(size) {}
+    ~Image() { munmap(addr, size); }
+    Image(Image const &) = delete;
+    Image& operator=(Image const &) = delete;
+
+    /* Mapuje plik path, zwraca pusty wskaźnik, jeśli plik nie jest
+     * poprawnym obrazem. Sprawdza nagłówek, rozmiar pliku i zmiany
+     * prefiksów, a pola tablicy tylko wtedy, gdy check_slots - w przeciwnym
+     * razie każde pole jest sprawdzane dopiero przez find, więc czas
+     * otwarcia nie zależy od wielkości obrazu */
+    static shared_ptr<const Image> open(char const *path, bool check_slots) {
+      int fd = ::open(path, O_RDONLY);
+      if (fd < 0)
+        return nullptr;
+      struct stat st;
+      if (fstat(fd, &st) != 0 ||
+          static_cast<size_t>(st.st_size) < sizeof(ImageHeader)) {
+        close(fd);
+        return nullptr;
+      }
+      size_t size = st.st_size;
+      void *addr = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+      close(fd);
+      if (addr == MAP_FAILED)
+        return nullptr;
+      shared_ptr<const Image> image = make_shared<Image>(addr, size);
+
+      ImageHeader const *h = image->header();
+      uint64_t n = h->slot_count;
+      size_t body = size - sizeof(ImageHeader);
+      uint64_t slots = body / sizeof(ImageSlot);
+      if (memcmp(h->magic, IMAGE_MAGIC, sizeof(IMAGE_MAGIC)) != 0 ||
+          n == 0 || (n & (n - 1)) != 0 || h->entry_count >= n ||
+          body % sizeof(ImageSlot) != 0 || h->prefix_count > slots ||
+          slots - h->prefix_count != n || !image->valid_prefixes() ||
+          (check_slots && !image->valid_slots()))
+        return nullptr;
+      madvise(addr, size, MADV_RANDOM);
+      return image;
+    }
+
+    /* Zwraca numer, na który zmieniono src, lub NULL, jeśli go nie ma.
+     * Uszkodzone pole traktuje jak brak wpisu */
+    char const* find(char const *src) const {
+      uint64_t mask = header()->slot_count - 1;
+      uint64_t i = image_hash(src) & mask;
+      for (uint64_t probe = 0; probe <= mask; ++probe, i = (i + 1) & mask) {
+        ImageSlot const &slot = slots()[i];
+        if (slot.src[0] == '\0')
+          return NULL;
+        /* src jest krótsze od pola, więc zgodność oznacza, że numer
+         * w polu jest poprawny i zakończony '\0' */
+        if (strncmp(slot.src, src, sizeof(slot.src)) == 0)
+          return valid_number(slot.dst, false) ? slot.dst : NULL;
+      }
+      return NULL;
+    }
+
+    size_t slot_count() const { return header()->slot_count; }
+    ImageSlot const& slot(size_t i) const { return slots()[i]; }
+    /* Czy pole i zawiera poprawny wpis */
+    bool used(size_t i) const {
+      ImageSlot const &s = slots()[i];
+      return s.src[0] != '\0' && valid_number(s.src, false) &&
+             valid_number(s.dst, false);
+    }
+    size_t prefix_count() const { return header()->prefix_count; }
+    ImageSlot const& prefix(size_t i) const {
+      return slots()[slot_count() + i];
+    }
+    size_t mapped_size() const { return size; }
+
+  private:
+    void *addr;
+    size_t size;
+
+    /* Sprawdza, czy pole zawiera numer zakończony '\0' wewnątrz pola,
+     * złożony z samych cyfr; pusty tylko wtedy, gdy empty */
+    static bool valid_number(char const (&s)[TEL_NUM_MAX_LEN + 1],
+                             bool empty) {
+      void const *end = memchr(s, '\0', sizeof(s));
+      if (end == NULL)
+        return false;
+      size_t len = static_cast<char const *>(end) - s;
+      for (size_t i = 0; i < len; ++i)
+        if (static_cast<unsigned char>(s[i] - '0') >= 10)
+          return false;
+      return empty ? len == 0 : len > 0;
+    }
+
+    /* Sprawdza, czy każda zmiana prefiksu zawiera dwa poprawne numery */
+    bool valid_prefixes() const {
+      for (size_t i = 0; i < prefix_count(); ++i)
+        if (!valid_number(prefix(i).src, false) ||
+            !valid_number(prefix(i).dst, false))
+          return false;
+      return true;
+    }
+
+    /* Sprawdza wszystkie pola tablicy: wolne pole jest całe puste, zajęte
+     * zawiera dwa poprawne numery, a zajętych pól jest tyle, ile podaje
+     * nagłówek */
+    bool valid_slots() const {
+      uint64_t count = 0;
+      for (size_t i = 0; i < slot_count(); ++i) {
+        ImageSlot const &s = slots()[i];
+        bool empty = s.src[0] == '\0';
+        if (!valid_number(s.src, empty) || !valid_number(s.dst, empty))
+          return false;
+        if (!empty)
+          ++count;
+      }
+      return count == header()->entry_count;
+    }
+
+    ImageHeader const* header() const {
+      return static_cast<ImageHeader const *>(addr);
+    }
+    ImageSlot const* slots() const {
+      return reinterpret_cast<ImageSlot const *>(header() + 1);
+    }
+  };
+
+  /* Wersja słownika: opcjonalny obraz wczytany z pliku oraz mapa zmian.
+   * Obraz nigdy nie jest modyfikowany - zmiany słownika wczytanego z pliku
+   * trafiają do map, a pusty numer w map oznacza usunięcie wpisu obrazu.
+   * Opublikowanej wersji nikt już nie zmienia. Węzły map i trie wszystkich
+   * wersji słownika pochodzą z jednej puli, z której przydziela tylko
+   * piszący tego słownika. */
+  struct Snapshot {
+    explicit Snapshot(shared_ptr<Arena> arena) : map(arena), trie(arena) {}
+    Snapshot(Snapshot const &) = default;
+
+    /* Kopia współdzieląca węzły z other, która nowe węzły przydziela
+     * z puli arena */
+    Snapshot(Snapshot const &other, shared_ptr<Arena> arena)
+      : image(other.image), map(other.map, arena), trie(other.trie, arena),
+        trie_numbers(other.trie_numbers), epoch(other.epoch) {}
+
+    shared_ptr<const Image> image;
+    MAPTEL map;
+    DigitTrie trie;                  // zmiany prefiksów
+    bool trie_numbers = false;       // czy zmiany numerów są w trie
+    uint64_t epoch = 0;              // numer kolejnej opublikowanej wersji
+  };
+
+  /* Liczniki operacji na słowniku, zwiększane bez synchronizacji
+   * z innymi operacjami */
+  struct Counters {
+    atomic<unsigned long long> inserts{0};
+    atomic<unsigned long long> erases{0};
+    atomic<unsigned long long> transforms{0};
+    atomic<unsigned long long> cycles{0};
+    atomic<unsigned long long> hops{0};
+    atomic<unsigned long long> truncated{0};
+  };
+
+  class ReverseIndex;
+  class AsyncWriter;
+  struct Waiting;
+
+  /* Słownik. Czytający przypinają bieżącą wersję (Pin) i podążają
+   * ciągiem zmian tylko w niej, więc nie czekają na piszących i nie widzą
+   * częściowo wykonanej zmiany. Piszący po kolei budują następną wersję
+   * i publikują ją atomowo, a zmiany numerów zlecone równolegle przez
+   * kilka wątków trafiają do jednej wersji (apply_now). */
+  struct Dict {
+    mutex writer;
+    shared_ptr<const Snapshot> current = // chroniony przez writer
+      make_shared<Snapshot>(make_shared<Arena>(MAPTEL_HUGEPAGES));
+    atomic<Snapshot const *> published{current.get()}; // current dla Pin
+    atomic<unsigned> phase{0};       // zmieniana przy każdej publikacji
+    atomic<long> readers[2] = {{0}, {0}}; // przypięcia wg parzystości fazy
+    Counters counters;
+    atomic<size_t> hop_limit{0};     // 0 - bez limitu
+    unique_ptr<ReverseIndex> index;  // opcjonalny, chroniony przez writer
+    mutex waiting_lock;              // chroni waiting
+    vector<Waiting *> waiting;       // zmiany czekające na writer
+    vector<Waiting *> applying;      // chroniony przez writer
+    unique_ptr<AsyncWriter> async;   // niszczony pierwszy, zatrzymuje wątek
+
+    /* Publikuje wersję next, a poprzednią zwalnia dopiero wtedy, gdy
+     * wypiszą się wszyscy czytający, którzy mogli ją przypiąć. Wymaga
+     * blokady writer, chyba że słownika nie widzą jeszcze inne wątki */
+    void publish(shared_ptr<const Snapshot> next) {
+      published.store(next.get());
+      shared_ptr<const Snapshot> previous = move(current);
+      current = move(next);
+      /* czytający zgłoszeni od tej chwili liczą się w drugim liczniku
+       * i przypną już next */
+      unsigned old_phase = phase.fetch_add(1);
+      while (readers[old_phase & 1].load() != 0)
+        this_thread::yield();
+    }
+
+    /* Bieżąca wersja do długiego przeglądania, np. przy zapisie obrazu.
+     * W przeciwieństwie do Pin czeka na blokadę writer, ale nie
+     * wstrzymuje potem publikacji kolejnych wersji */
+    shared_ptr<const Snapshot> share() {
+      lock_guard<mutex> lock(writer);
+      return current;
+    }
+  };
+
+  /* Wersja słownika przypięta przez czytającego na czas istnienia obiektu.
+   * Przypięcie nie bierze blokady: czytający zgłasza się w liczniku
+   * bieżącej fazy i ponawia zgłoszenie tylko wtedy, gdy piszący zmienił
+   * w tym czasie fazę. Kosztuje więc kilka operacji atomowych, ale
+   * publikujący czeka na wypisanie się czytających poprzedniej wersji,
+   * dlatego przypięcia są krótkie, a przypinający nie zmienia w ich
+   * trakcie tego słownika */
+  class Pin {
+  public:
+    explicit Pin(Dict &d) {
+      for (;;) {
+        unsigned phase = d.phase.load();
+        readers = &d.readers[phase & 1];
+        readers->fetch_add(1);
+        if (d.phase.load() == phase)
+          break;
+        readers->fetch_sub(1);
+      }
+      snapshot = d.published.load();
+    }
+
+    ~Pin() { readers->fetch_sub(1); }
+
+    Pin(Pin const &) = delete;
+    Pin& operator=(Pin const &) = delete;
+
+    Snapshot const& operator*() const { return *snapshot; }
+    Snapshot const* operator->() const { return snapshot; }
+
+  private:
+    atomic<long> *readers;
+    Snapshot const *snapshot;
+  };
+
+  /* Tablica słowników. Identyfikator słownika to numer jego pozycji
+   * w tablicy (młodsze bity) i pokolenie tej pozycji, zwiększane przy
+   * usunięciu słownika, więc nieaktualny identyfikator zostaje wykryty.
+   * Pozycje są przydzielane kawałkami, które nigdy nie są przenoszone,
+   * dlatego znalezienie słownika to odczyt z tablicy bez blokady. */
+  class Registry {
+  public:
+    Registry() {
+      for (auto &chunk : chunks)
+        chunk.store(NULL, memory_order_relaxed);
+    }
+
+    ~Registry() {
+      for (auto &chunk : chunks) {
+        Slot *slots = chunk.load(memory_order_relaxed);
+        if (slots == NULL)
+          continue;
+        for (size_t i = 0; i < CHUNK_SIZE; ++i)
+          delete slots[i].dict.load(memory_order_relaxed);
+        delete[] slots;
+      }
+    }
+
+    /* Zwraca słownik o identyfikatorze id */
+    Dict& get(unsigned long id) const {
+      size_t index = id & SLOT_MASK;
+      Slot const *chunk = chunks[index / CHUNK_SIZE].load(
+        memory_order_acquire);
+      assert(chunk != NULL);         // czy istnieje słownik o danym id
+      Slot const &slot = chunk[index % CHUNK_SIZE];
+      Dict *d = slot.dict.load(memory_order_acquire);
+      assert(d != NULL &&            // czy słownik nie został usunięty
+             slot.generation.load(memory_order_relaxed) == id >> SLOT_BITS);
+      return *d;
+    }
+
+    /* Rejestruje słownik d i zwraca jego identyfikator */
+    unsigned long add(unique_ptr<Dict> d) {
+      lock_guard<mutex> lock(m);
+      size_t index;
+      if (!free_slots.empty()) {
+        index = free_slots.back();
+        free_slots.pop_back();
+      } else {
+        assert(used < MAX_SLOTS);    //przepełnienie
+        index = used++;
+        if (index % CHUNK_SIZE == 0)
+          chunks[index / CHUNK_SIZE].store(new Slot[CHUNK_SIZE],
+                                           memory_order_release);
+      }
+      Slot &slot = chunks[index / CHUNK_SIZE].load()[index % CHUNK_SIZE];
+      slot.dict.store(d.release(), memory_order_release);
+      return slot.generation.load(memory_order_relaxed) << SLOT_BITS |
+             index;
+    }
+
+    /* Wyrejestrowuje słownik o identyfikatorze id i oddaje go */
+    unique_ptr<Dict> remove(unsigned long id) {
+      lock_guard<mutex> lock(m);
+      size_t index = id & SLOT_MASK;
+      Slot *chunk = chunks[index / CHUNK_SIZE].load();
+      assert(chunk != NULL);         // czy istnieje słownik o danym id
+      Slot &slot = chunk[index % CHUNK_SIZE];
+      assert(slot.dict.load() != NULL &&
+             slot.generation.load() == id >> SLOT_BITS);
+      unique_ptr<Dict> d(slot.dict.exchange(NULL));
+      slot.generation.fetch_add(1);
+      free_slots.push_back(index);
+      return d;
+    }
+
+  private:
+    struct Slot {
+      atomic<unsigned long> generation{0};
+      atomic<Dict *> dict{nullptr};
+    };
+
+    static const unsigned SLOT_BITS = 22;
+    static const size_t MAX_SLOTS = static_cast<size_t>(1) << SLOT_BITS;
+    static const unsigned long SLOT_MASK = MAX_SLOTS - 1;
+    static const size_t CHUNK_SIZE = 1024;
+
+    atomic<Slot *> chunks[MAX_SLOTS / CHUNK_SIZE];
+    mutex m;                         // chroni przydział pozycji
+    size_t used = 0;                 // liczba kiedykolwiek użytych pozycji
+    vector<size_t> free_slots;
+  };
+
+  /* Tworzy tablicę służącą do trzymania wielu słowników */
+  Registry& dicts() {
+    static Registry registry;
+    return registry;
+  }
+
+  /* Zwraca słownik o identyfikatorze id */
+  Dict& get_dict(unsigned long id) {
+    return dicts().get(id);
+  }
+
+  /* Rejestruje nowy słownik i zwraca jego identyfikator */
+  unsigned long add_dict(unique_ptr<Dict> d) {
+    unsigned long id = dicts().add(move(d));
+    if (tracing)
+      trace(MAPTEL_TRACE_CREATE, id);
+
+    return id;
+  }
+
+  /* Buduje następną wersję słownika funkcją change i publikuje ją,
+   * jeśli change zwróci true. Wymaga blokady d.writer */
+  template <typename F>
+  void update_locked(Dict &d, F change) {
+    shared_ptr<Snapshot> next = make_shared<Snapshot>(*d.current);
+    if (change(*next)) {
+      ++next->epoch;
+      d.publish(move(next));
+    }
+  }
+
+  template <typename F>
+  void update(Dict &d, F change) {
+    lock_guard<mutex> lock(d.writer);
+    update_locked(d, change);
+  }
+
+  /* Szuka zmiany numeru s pamiętanej w trie lub w map */
+  Number const* find_number(Snapshot const &d, Number const &s) {
+    return d.trie_numbers ? d.trie.find_number(s) : d.map.find(s);
+  }
+
+  /* Szuka zmiany numeru s (bez zmian prefiksów), zapisuje ją w dst */
+  bool lookup_number(Snapshot const &d, Number const &s, Number &dst,
+                     Number const *found) {
+    if (found != NULL) {
+      if (found->empty())            // wpis obrazu usunięty
+        return false;
+      dst = *found;
+      return true;
+    }
+    if (d.image) {
+      char const *found_image = d.image->find(s.c_str());
+      if (found_image != NULL) {
+        dst = Number(found_image);
+        return true;
+      }
+    }
+    return false;
+  }
+
+  bool lookup_number(Snapshot const &d, Number const &s, Number &dst) {
+    return lookup_number(d, s, dst, find_number(d, s));
+  }
+
+  bool lookup_number(Snapshot const &d, string const &s, string &dst) {
+    Number found;
+    if (!lookup_number(d, Number(s), found))
+      return false;
+    dst.assign(found.c_str(), found.size());
+    return true;
+  }
+
+  /* Szuka zmiany numeru s w słowniku, zapisuje ją w dst. Zmiana numeru ma
+   * pierwszeństwo przed zmianą najdłuższego pasującego prefiksu */
+  bool lookup(Snapshot const &d, Number const &s, Number &dst) {
+    if (d.trie.empty())
+      return lookup_number(d, s, dst);
+
+    DigitTrie::Match m = d.trie.match(s);
+    if (lookup_number(d, s, dst,
+                      d.trie_numbers ? m.number : d.map.find(s)))
+      return true;
+    if (m.prefix != NULL &&
+        m.prefix->size() + s.size() - m.prefix_len <= TEL_NUM_MAX_LEN) {
+      dst = *m.prefix;
+      dst.append(s.substr(m.prefix_len, s.size() - m.prefix_len));
+      return true;
+    }
+    return false;
+  }
+
+  /* Wywołuje f(src, dst) dla każdej zmiany numeru zapisanej w słowniku */
+  template <typename F>
+  void for_each_entry(Snapshot const &d, F f) {
+    auto visit = [&f](Number const &src, Number const &dst) {
+      if (!dst.empty())
+        f(src.c_str(), dst.c_str());
+    };
+    if (d.trie_numbers)
+      d.trie.for_each_number(visit);
+    else
+      d.map.for_each(visit);
+    if (d.image) {
+      for (size_t i = 0; i < d.image->slot_count(); ++i) {
+        ImageSlot const &slot = d.image->slot(i);
+        if (d.image->used(i) && find_number(d, slot.src) == NULL)
+          f(slot.src, slot.dst);
+      }
+    }
+  }
+
+  /* Zapisuje zmianę numeru src w map lub w trie */
+  void set_number(Snapshot &d, Number const &src, Number const &dst) {
+    if (d.trie_numbers)
+      d.trie.set_number(src, dst);
+    else
+      d.map.set(src, dst);
+  }
+
+  /* Podąża ciągiem kolejnych zmian od numeru s i zapisuje w s końcowy
+   * numer, a w hops liczbę przebytych zmian. Zwraca false, jeśli zmiany
+   * prowadzą do cyklu - wtedy s jest nieokreślone. Jeśli limit > 0, to
+   * przerywa po limit zmianach z osiągniętym numerem w s i ustawia
+   * truncated. Numery już odwiedzone pamięta najpierw w tablicy na stosie,
+   * przeszukiwanej liniowo, a dopiero w długich ciągach także w zbiorze,
+   * więc zwykłe przekształcenie nie przydziela pamięci */
+  bool find_dst(Snapshot const &d, Number &s, size_t &hops,
+                size_t limit, bool &truncated) {
+    static const size_t SEEN_INLINE = 16;
+    Number seen[SEEN_INLINE];
+    unordered_set<Number> seen_more;
+    Number next;
+
+    hops = 0;
+    truncated = false;
+    while (lookup(d, s, next)) {
+      size_t inline_count = min(hops, SEEN_INLINE);
+      if (find(seen, seen + inline_count, s) != seen + inline_count ||
+          (!seen_more.empty() && seen_more.count(s) > 0))
+        return false;
+      if (hops == limit && limit > 0) {
+        truncated = true;
+        break;
+      }
+      if (hops < SEEN_INLINE)
+        seen[hops] = s;
+      else
+        seen_more.insert(s);
+      ++hops;
+      s = next;
+    }
+    return true;
+  }
+
+  bool find_dst(Snapshot const &d, Number &s, size_t &hops) {
+    bool truncated;
+    return find_dst(d, s, hops, 0, truncated);
+  }
+
+  /* Indeks odwrotny słownika: dla każdego numeru zbiór numerów, które
+   * bezpośrednio na niego zmieniono, oraz wszystkie cykle zmian.
+   * Uwzględnia tylko zmiany pojedynczych numerów, bez zmian prefiksów.
+   * Uaktualniany przy każdej zmianie słownika kosztem jednego przejścia
+   * ciągiem zmian, więc zapytania kosztują O(wielkość odpowiedzi) */
+  class ReverseIndex {
+  public:
+    explicit ReverseIndex(Snapshot const &d) {
+      for_each_entry(d, [this](char const *src, char const *dst) {
+        sources[dst].insert(src);
+      });
+      /* każdy numer odwiedzany jest raz, cykl to powrót do numeru
+       * odwiedzonego w tym samym przejściu */
+      unordered_map<string, size_t> walk_of;
+      size_t walk = 0;
+      for_each_entry(d, [&](char const *src, char const *) {
+        ++walk;
+        vector<string> path;
+        string s (src);
+        string next;
+        while (walk_of.count(s) == 0) {
+          walk_of[s] = walk;
+          path.push_back(s);
+          if (!lookup_number(d, s, next))
+            return;
+          s = next;
+        }
+        if (walk_of[s] == walk)
+          add_cycle(vector<string>(find(path.begin(), path.end(), s),
+                                   path.end()));
+      });
+    }
+
+    /* Uaktualnia indeks po zmianie numeru src z old_dst na new_dst, pusty
+     * numer oznacza brak zmiany. d to wersja słownika już po zmianie */
+    void changed(Snapshot const &d, string const &src,
+                 string const &old_dst, string const &new_dst) {
+      if (!old_dst.empty()) {
+        auto it = sources.find(old_dst);
+        it->second.erase(src);
+        if (it->second.empty())
+          sources.erase(it);
+        drop_cycle(src);
+      }
+      if (!new_dst.empty()) {
+        sources[new_dst].insert(src);
+        detect_cycle(d, src);
+      }
+    }
+
+    /* Zapisuje w out wszystkie numery, które d przekształca w dst */
+    void sources_of(Snapshot const &d, string const &dst,
+                    vector<string> &out) const {
+      string next;
+      if (lookup_number(d, dst, next))  // dst nie kończy żadnego ciągu
+        return;
+      vector<string const *> stack{&dst};
+      while (!stack.empty()) {
+        auto it = sources.find(*stack.back());
+        stack.pop_back();
+        if (it == sources.end())
+          continue;
+        for (string const &src : it->second) {
+          out.push_back(src);
+          stack.push_back(&src);
+        }
+      }
+    }
+
+    /* Zapisuje w out wszystkie cykle zmian */
+    void find_cycles(vector<vector<string>> &out) const {
+      for (auto const &c : cycles)
+        out.push_back(c.second);
+    }
+
+    size_t memory_usage() const {
+      return sizeof(*this) + heap_bytes(sources) + heap_bytes(cycle_of) +
+             heap_bytes(cycles);
+    }
+
+  private:
+    unordered_map<string, unordered_set<string>> sources;
+    unordered_map<string, size_t> cycle_of; // numer -> identyfikator cyklu
+    unordered_map<size_t, vector<string>> cycles;
+    size_t next_cycle = 0;
+
+    void add_cycle(vector<string> cycle) {
+      size_t id = next_cycle++;
+      for (string const &s : cycle)
+        cycle_of[s] = id;
+      cycles[id] = move(cycle);
+    }
+
+    /* Usuwa cykl, na którym leży numer src, jeśli taki jest */
+    void drop_cycle(string const &src) {
+      auto it = cycle_of.find(src);
+      if (it == cycle_of.end())
+        return;
+      size_t cycle = it->second;
+      for (string const &s : cycles[cycle])
+        cycle_of.erase(s);
+      cycles.erase(cycle);
+    }
+
+    /* Sprawdza, czy ciąg zmian zaczynający się w src wraca do src.
+     * Wszystkie cykle nieprzechodzące przez src są już w indeksie,
+     * więc przejście kończy się najpóźniej na pierwszym z nich */
+    void detect_cycle(Snapshot const &d, string const &src) {
+      vector<string> path{src};
+      string next;
+      while (lookup_number(d, path.back(), next)) {
+        if (next == src) {
+          add_cycle(move(path));
+          return;
+        }
+        if (cycle_of.count(next) > 0)
+          return;
+        path.push_back(next);
+      }
+    }
+  };
+
+  /* Zmienia numer src na dst w budowanej wersji next słownika d */
+  void set_change(Dict &d, Snapshot &next, string const &src,
+                  string const &dst) {
+    string old_dst;
+    if (d.index)
+      lookup_number(next, src, old_dst);
+    set_number(next, src, dst);
+    if (d.index)
+      d.index->changed(next, src, old_dst, dst);
+  }
+
+  /* Usuwa zmianę numeru src z budowanej wersji next słownika d,
+   * zwraca false, jeśli jej nie było */
+  bool erase_change(Dict &d, Snapshot &next, string const &src) {
+    string old_dst;
+    if (!lookup_number(next, src, old_dst))
+      return false;
+    if (next.image && next.image->find(src.c_str()) != NULL)
+      set_number(next, src, "");     // przesłania wpis obrazu
+    else if (next.trie_numbers)
+      next.trie.erase_number(src);
+    else
+      next.map.erase(src);
+    if (d.index)
+      d.index->changed(next, src, old_dst, "");
+    return true;
+  }
+  
+  /* Nieblokująca kolejka wielu producentów i jednego konsumenta (Wiukow).
+   * Producent dołącza węzeł na koniec jedną operacją exchange, konsument
+   * zdejmuje węzły z początku bez synchronizacji z producentami. Pierwszy
+   * węzeł jest zawsze atrapą - węzeł zdjętego elementu staje się nową
+   * atrapą. */
+  template <typename T>
+  class MpscQueue {
+  public:
+    MpscQueue() : last(new Node), first(last.load()) {}
+
+    ~MpscQueue() {
+      T value;
+      while (pop(value)) {}
+      delete first;
+    }
+
+    void push(T value) {
+      Node *node = new Node;
+      node->value = move(value);
+      Node *prev = last.exchange(node, memory_order_acq_rel);
+      prev->next.store(node, memory_order_release);
+    }
+
+    /* Wywoływana tylko przez konsumenta. Zwraca false, jeśli kolejka jest
+     * pusta lub producent nie dołączył jeszcze swojego węzła
+     * do poprzedniego */
+    bool pop(T &value) {
+      Node *next = first->next.load(memory_order_acquire);
+      if (next == nullptr)
+        return false;
+      value = move(next->value);
+      delete first;
+      first = next;
+      return true;
+    }
+
+  private:
+    struct Node {
+      atomic<Node*> next{nullptr};
+      T value;
+    };
+
+    atomic<Node*> last;              // ostatni dołączony węzeł
+    Node *first;                     // atrapa, należy do konsumenta
+  };
+
+  /* Punkt, na który czeka maptel_flush */
+  struct Barrier {
+    mutex m;
+    condition_variable applied;
+    bool done = false;
+  };
+
+  /* Zmiana numeru zlecona w trybie zapisu w tle lub czekająca na
+   * zastosowanie poza nim */
+  struct Request {
+    enum Kind { INSERT, ERASE, BARRIER } kind = INSERT;
+    string src;
+    string dst;
+    Barrier *barrier = nullptr;
+  };
+
+  /* Stosuje zmianę r w budowanej wersji next słownika d, zwraca true,
+   * jeśli ją zmieniła */
+  bool apply_change(Dict &d, Snapshot &next, Request const &r) {
+    if (r.kind == Request::INSERT) {
+      set_change(d, next, r.src, r.dst);
+      return true;
+    }
+    return r.kind == Request::ERASE && erase_change(d, next, r.src);
+  }
+
+  /* Zapis w tle. Wywołujący tylko dołączają zmiany do kolejki, a osobny
+   * wątek zdejmuje je partiami i stosuje każdą partię w jednej nowej
+   * wersji słownika, w kolejności dołączenia. Wątek śpi, gdy kolejka
+   * jest pusta; budzi go producent, który dołączył pierwszą zmianę.
+   * Zdarzenia śledzenia zmian zgłasza wątek po opublikowaniu partii, gdy
+   * maptel_transform już je widzi. */
+  class AsyncWriter {
+  public:
+    AsyncWriter(Dict &d, unsigned long id)
+      : d(d), id(id), pending(0), stopping(false),
+        worker(&AsyncWriter::run, this) {}
+
+    /* Stosuje wszystkie zlecone zmiany i zatrzymuje wątek */
+    ~AsyncWriter() {
+      {
+        lock_guard<mutex> lock(m);
+        stopping = true;
+      }
+      wake.notify_one();
+      worker.join();
+    }
+
+    void push(Request r) {
+      queue.push(move(r));
+      if (pending.fetch_add(1, memory_order_acq_rel) == 0) {
+        lock_guard<mutex> lock(m);
+        wake.notify_one();
+      }
+    }
+
+    /* Czeka na zastosowanie wszystkich zmian dołączonych wcześniej */
+    void flush() {
+      Barrier b;
+      Request r;
+      r.kind = Request::BARRIER;
+      r.barrier = &b;
+      push(move(r));
+      unique_lock<mutex> lock(b.m);
+      b.applied.wait(lock, [&b]() { return b.done; });
+    }
+
+  private:
+    /* Największa liczba zmian stosowanych w jednej wersji */
+    static const size_t BATCH_SIZE = 4096;
+
+    Dict &d;
+    unsigned long id;                // identyfikator d, do śledzenia
+    MpscQueue<Request> queue;
+    atomic<size_t> pending;          // dołączone i jeszcze nie zastosowane
+    mutex m;
+    condition_variable wake;
+    bool stopping;                   // chroniony przez m
+    thread worker;                   // ostatni, startuje po pozostałych
+
+    void run() {
+      vector<Request> batch;
+      for (;;) {
+        batch.clear();
+        Request r;
+        while (batch.size() < BATCH_SIZE && queue.pop(r)) {
+          batch.push_back(move(r));
+          if (batch.back().kind == Request::BARRIER)
+            break;
+        }
+        if (!batch.empty()) {
+          apply(batch);
+          continue;
+        }
+        if (pending.load(memory_order_acquire) > 0) {
+          this_thread::yield();      // producent w trakcie dołączania
+          continue;
+        }
+        unique_lock<mutex> lock(m);
+        wake.wait(lock, [this]() {
+          return stopping || pending.load(memory_order_acquire) > 0;
+        });
+        if (pending.load(memory_order_acquire) == 0)
+          return;
+      }
+    }
+
+    void apply(vector<Request> const &batch) {
+      vector<bool> results;
+      update(d, [&](Snapshot &next) {
+        bool changed = false;
+        for (auto const &r : batch) {
+          results.push_back(apply_change(d, next, r));
+          changed |= results.back();
+        }
+        return changed;
+      });
+      if (tracing)
+        for (size_t i = 0; i < batch.size(); ++i) {
+          Request const &r = batch[i];
+          if (r.kind == Request::INSERT)
+            trace(MAPTEL_TRACE_INSERT, id, r.src.c_str(), r.dst.c_str());
+          else if (r.kind == Request::ERASE)
+            trace(MAPTEL_TRACE_ERASE, id, r.src.c_str(), NULL, NULL, 0,
+                  results[i]);
+        }
+      pending.fetch_sub(batch.size(), memory_order_acq_rel);
+
+      Barrier *b = batch.back().barrier;
+      if (b != nullptr) {
+        /* powiadomienie pod blokadą - czekający zniszczy b zaraz po
+         * jej zwolnieniu */
+        lock_guard<mutex> lock(b->m);
+        b->done = true;
+        b->applied.notify_one();
+      }
+    }
+  };
+
+  /* Bajty zajmowane przez wersję słownika wraz z pulami jej węzłów
+   * i zmapowanym obrazem */
+  size_t memory_usage(Snapshot const &s) {
+    size_t bytes = sizeof(Snapshot) + SHARED_BLOCK_OVERHEAD;
+    for (Arena const *a = s.map.arena().get(); a != nullptr;
+         a = a->parent().get())
+      bytes += a->reserved();
+    if (s.image)
+      bytes += s.image->mapped_size();
+    return bytes;
+  }
+
+  /* Zmiana czekająca na blokadę piszącego poza trybem zapisu w tle */
+  struct Waiting {
+    Request const *request;
+    bool applied = false;            // chronione przez Dict::writer
+    bool changed = false;
+  };
+
+  /* Stosuje zmianę r poza trybem zapisu w tle i zwraca true, jeśli
+   * zmieniła słownik. Wątki zmieniające słownik równolegle nie budują
+   * każdy swojej wersji: wszystkie zmiany czekające na blokadę piszącego
+   * stosuje w jednej nowej wersji wątek, który dostanie ją pierwszy,
+   * a pozostałe po jej uzyskaniu tylko odczytują wynik */
+  bool apply_now(Dict &d, Request const &r) {
+    Waiting w;
+    w.request = &r;
+    {
+      lock_guard<mutex> lock(d.waiting_lock);
+      d.waiting.push_back(&w);
+    }
+    lock_guard<mutex> lock(d.writer);
+    if (!w.applied) {
+      {
+        lock_guard<mutex> waiting(d.waiting_lock);
+        d.applying.swap(d.waiting);
+      }
+      update_locked(d, [&d](Snapshot &next) {
+        bool changed = false;
+        for (Waiting *c : d.applying) {
+          c->changed = apply_change(d, next, *c->request);
+          c->applied = true;
+          changed |= c->changed;
+        }
+        return changed;
+      });
+      d.applying.clear();
+    }
+    return w.changed;
+  }
+
+  /* W trybie zapisu w tle stosuje zlecone zmiany przed operacją, która
+   * zmienia lub zapisuje cały słownik */
+  void flush_queue(Dict &d) {
+    if (d.async)
+      d.async->flush();
+  }
+  
+  /* Widok warstwowy: numer jest przekształcany kolejno przez słowniki
+   * warstw, tak jak kolejnymi wywołaniami maptel_transform. Każda warstwa
+   * pamięta wyniki przekształceń razem z numerem wersji słownika, z której
+   * pochodzą, i limitem zmian, z którym je obliczono; nowa wersja słownika
+   * lub zmiana jego limitu unieważnia pamiętane wyniki jego warstwy,
+   * a wyniki pozostałych warstw zostają. */
+  class Overlay {
+  public:
+    explicit Overlay(vector<unsigned long> ids) : layers(ids.size()) {
+      for (size_t i = 0; i < ids.size(); ++i)
+        layers[i].id = ids[i];
+    }
+
+    /* Przekształca s przez wszystkie warstwy, zwraca true, jeśli
+     * w którejś przekroczono limit zmian */
+    bool transform(string &s) {
+      bool truncated = false;
+      for (Layer &layer : layers) {
+        Dict &d = get_dict(layer.id);
+        Pin snapshot(d);
+        size_t limit = d.hop_limit.load(memory_order_relaxed);
+        bool cut;
+        if (layer.find(snapshot->epoch, limit, s, cut)) {
+          truncated |= cut;
+          continue;
+        }
+        string src (s);
+        Number result (s);
+        size_t hops;
+        if (find_dst(*snapshot, result, hops, limit, cut))
+          s = result.str();          // cykl pozostawia numer bez zmian
+        truncated |= cut;
+        layer.remember(snapshot->epoch, limit, src, s, cut);
+      }
+      return truncated;
+    }
+
+  private:
+    /* Największa liczba wyników pamiętanych przez jedną warstwę */
+    static const size_t CACHE_SIZE = 1 << 16;
+
+    struct Layer {
+      unsigned long id = 0;
+      mutex m;
+      uint64_t epoch = 0;            // wersja, z której pochodzą wyniki
+      size_t limit = 0;              // limit zmian, z którym je obliczono
+      /* wynik i to, czy przekształcenie przerwano po limicie zmian */
+      unordered_map<string, pair<string, bool>> hits;
+
+      bool find(uint64_t current, size_t current_limit, string &s,
+                bool &truncated) {
+        lock_guard<mutex> lock(m);
+        if (epoch != current || limit != current_limit) {
+          hits.clear();
+          epoch = current;
+          limit = current_limit;
+          return false;
+        }
+        auto it = hits.find(s);
+        if (it == hits.end())
+          return false;
+        s = it->second.first;
+        truncated = it->second.second;
+        return true;
+      }
+
+      void remember(uint64_t current, size_t current_limit,
+                    string const &src, string const &dst, bool truncated) {
+        lock_guard<mutex> lock(m);
+        if (epoch != current || limit != current_limit)
+          return;
+        if (hits.size() >= CACHE_SIZE)
+          hits.clear();
+        hits.emplace(src, make_pair(dst, truncated));
+      }
+    };
+
+    vector<Layer> layers;
+  };
+
+  /* Widoki warstwowe, identyfikowane niezależnie od słowników */
+  class Overlays {
+  public:
+    unsigned long add(vector<unsigned long> ids) {
+      lock_guard<mutex> lock(m);
+      unsigned long id = ++last_id;
+      overlays.emplace(id, make_shared<Overlay>(move(ids)));
+      return id;
+    }
+
+    shared_ptr<Overlay> get(unsigned long id) {
+      lock_guard<mutex> lock(m);
+      auto it = overlays.find(id);
+      assert(it != overlays.end());    // czy istnieje widok o danym id
+      return it->second;
+    }
+
+    void remove(unsigned long id) {
+      lock_guard<mutex> lock(m);
+      size_t removed = overlays.erase(id);
+      assert(removed == 1);
+      (void) removed;
+    }
+
+  private:
+    mutex m;
+    unsigned long last_id = 0;
+    unordered_map<unsigned long, shared_ptr<Overlay>> overlays;
+  };
+
+  Overlays& overlays() {
+    static Overlays registry;
+    return registry;
   }
   
   /* Sprawdza czy wskaźnik nie jest NULL, 
    * czy wszystkie znaki do cyfry,
    * czy numer telefonu jest zakończony znakiem '\0' oraz
-   * czy ma długość <= TEL_NUM_MAX_LEN */
-  bool if_string_correct(char const *s) {
+   * czy ma długość <= TEL_NUM_MAX_LEN.
+   * Jeśli tak, zapisuje długość numeru w len.
+   * Z SSE2 sprawdza po 16 bajtów naraz: cały numer mieści się w co
+   * najwyżej trzech wyrównanych blokach. Wyrównany odczyt nie przekracza
+   * granicy strony, więc może bezpiecznie sięgać poza koniec napisu,
+   * a bajty bloku przed początkiem napisu są pomijane */
+#ifdef __SSE2__
+  __attribute__((no_sanitize_address))
+  bool if_string_correct(char const *s, size_t &len) {
+    if (s == NULL)
+      return false;
+    uintptr_t addr = reinterpret_cast<uintptr_t>(s);
+    __m128i const *block =
+      reinterpret_cast<__m128i const *>(addr & ~static_cast<uintptr_t>(15));
+    unsigned skip = addr & 15;
+    __m128i below = _mm_set1_epi8('0' - 1);
+    __m128i above = _mm_set1_epi8('9' + 1);
+    size_t base = 0;                 // liczba bajtów napisu przed blokiem
+    for (;; ++block) {
+      __m128i x = _mm_load_si128(block);
+      unsigned nul = _mm_movemask_epi8(_mm_cmpeq_epi8(x, _mm_setzero_si128()));
+      unsigned digit = _mm_movemask_epi8(
+        _mm_and_si128(_mm_cmpgt_epi8(x, below), _mm_cmplt_epi8(x, above)));
+      nul >>= skip;
+      digit >>= skip;
+      unsigned width = 16 - skip;
+      skip = 0;
+      if (nul != 0) {
+        unsigned end = __builtin_ctz(nul);
+        unsigned before = (1u << end) - 1;
+        if ((digit & before) != before || base + end > TEL_NUM_MAX_LEN)
+          return false;
+        len = base + end;
+        return true;
+      }
+      if (digit != (1u << width) - 1 || base + width > TEL_NUM_MAX_LEN)
+        return false;
+      base += width;
+    }
+  }
+#else
+  bool if_string_correct(char const *s, size_t &len) {
     if (s == NULL)
       return false;
     for (size_t i = 0; i <= TEL_NUM_MAX_LEN; i++) {
-      if (*(s + i) == '\0')
+      if (*(s + i) == '\0') {
+        len = i;
         return true;
+      }
       if (!isdigit(*(s + i)))
         return false;
     }
 
     return false;
   }
+#endif
+
+  /* Zwraca numer s jako string. Długość znana ze sprawdzenia numeru
+   * oszczędza osobnego przejścia w poszukiwaniu '\0' */
+  string read_number(char const *s) {
+    size_t len = 0;
+    bool correct = if_string_correct(s, len);
+    assert(correct);
+    return correct ? string(s, len) : string(s);
+  }
+
+  /* Zwraca numer s jako Number, bez przydzielania pamięci */
+  Number read_key(char const *s) {
+    size_t len = 0;
+    bool correct = if_string_correct(s, len);
+    assert(correct);
+    return correct ? Number(s, len) : Number(s, strnlen(s, TEL_NUM_MAX_LEN));
+  }
+
+  /* Zapisuje obraz do pliku tymczasowego i podmienia nim plik path,
+   * aby równolegle wczytujący proces nie zobaczył niepełnego obrazu.
+   * Pola obrazu wypełnia fill(slots) wprost w zmapowanym pliku, więc
+   * tablica nie powstaje osobno w pamięci procesu */
+  template <typename F>
+  bool write_image(char const *path, ImageHeader const &header, F fill) {
+    string tmp_path = string(path) + ".tmp";
+    size_t size = sizeof(ImageHeader) +
+      (header.slot_count + header.prefix_count) * sizeof(ImageSlot);
+    int fd = ::open(tmp_path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0666);
+    if (fd < 0)
+      return false;
+    /* miejsce na dysku przydzielone z góry - zapis do zmapowanego pliku
+     * bez niego kończy się sygnałem SIGBUS, gdy dysk się zapełni */
+    void *addr = MAP_FAILED;
+    if (posix_fallocate(fd, 0, size) == 0)
+      addr = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    bool ok = addr != MAP_FAILED;
+    if (ok) {
+      memcpy(addr, &header, sizeof(header));
+      fill(reinterpret_cast<ImageSlot *>(static_cast<ImageHeader *>(addr) +
+                                         1));
+      ok = munmap(addr, size) == 0;
+    }
+    ok = (close(fd) == 0) && ok;
+    if (ok)
+      ok = rename(tmp_path.c_str(), path) == 0;
+    if (!ok)
+      remove(tmp_path.c_str());
+    return ok;
+  }
+
+  /* Para numerów wskazująca na fragment wczytywanego pliku */
+  struct RawPair {
+    char const *src;
+    char const *dst;
+    size_t src_len;
+    size_t dst_len;
+  };
+
+  /* Minimalny rozmiar fragmentu pliku parsowanego przez jeden wątek */
+  const size_t MIN_CHUNK_SIZE = 1 << 20;
+
+  bool is_blank(char c) {
+    return c == ' ' || c == '\t' || c == '\r';
+  }
+
+  /* Wczytuje numer zaczynający się w p i przesuwa p za niego.
+   * Zwraca długość numeru lub 0, jeśli numer jest pusty albo za długi */
+  size_t scan_number(char const *&p, char const *end) {
+    char const *begin = p;
+    while (p != end && static_cast<unsigned char>(*p - '0') < 10)
+      ++p;
+    size_t len = p - begin;
+    return len <= TEL_NUM_MAX_LEN ? len : 0;
+  }
+
+  /* Parsuje linie z przedziału [p, end) do wektora out.
+   * Puste linie są pomijane. Zwraca false, jeśli któraś linia
+   * nie jest parą poprawnych numerów */
+  bool parse_pairs(char const *p, char const *end, vector<RawPair> &out) {
+    out.reserve(count(p, end, '\n') + 1);
+    while (p != end) {
+      while (p != end && is_blank(*p))
+        ++p;
+      if (p != end && *p == '\n') {
+        ++p;
+        continue;
+      }
+      if (p == end)
+        break;
+
+      RawPair pair;
+      pair.src = p;
+      pair.src_len = scan_number(p, end);
+      if (pair.src_len == 0 || p == end || !is_blank(*p))
+        return false;
+      while (p != end && is_blank(*p))
+        ++p;
+      pair.dst = p;
+      pair.dst_len = scan_number(p, end);
+      if (pair.dst_len == 0)
+        return false;
+      while (p != end && is_blank(*p))
+        ++p;
+      if (p != end && *p++ != '\n')
+        return false;
+      out.push_back(pair);
+    }
+    return true;
+  }
+
+  /* Dzieli tekst [data, data + size) na fragmenty kończące się na granicy
+   * linii i parsuje je równolegle. Fragmenty w parts są w kolejności
+   * występowania w pliku */
+  bool parse_pairs_parallel(char const *data, size_t size,
+                            vector<vector<RawPair>> &parts) {
+    size_t threads = max<size_t>(1, thread::hardware_concurrency());
+    threads = min(threads, max<size_t>(1, size / MIN_CHUNK_SIZE));
+
+    vector<char const *> bounds{data};
+    for (size_t i = 1; i < threads; ++i) {
+      char const *b = max(bounds.back(), data + size / threads * i);
+      b = find(b, data + size, '\n');
+      bounds.push_back(b == data + size ? b : b + 1);
+    }
+    bounds.push_back(data + size);
+
+    parts.assign(threads, vector<RawPair>());
+    vector<char> ok(threads);
+    vector<thread> workers;
+    for (size_t i = 1; i < threads; ++i)
+      workers.emplace_back([&, i]() {
+        ok[i] = parse_pairs(bounds[i], bounds[i + 1], parts[i]);
+      });
+    ok[0] = parse_pairs(bounds[0], bounds[1], parts[0]);
+    for (auto &w : workers)
+      w.join();
+    return count(ok.begin(), ok.end(), 0) == 0;
+  }
 }
 
 unsigned long maptel_create() {
-  if (debug)
-    cerr << "maptel: maptel_create()\n";
-  static unsigned long next_id;      // id przydzielane słownikom
+  return add_dict(unique_ptr<Dict>(new Dict));
+}
+
+unsigned long maptel_create_trie() {
+  unique_ptr<Dict> d(new Dict);
+  shared_ptr<Snapshot> empty = make_shared<Snapshot>(*d->current);
+  empty->trie_numbers = true;
+  d->publish(move(empty));
+  return add_dict(move(d));
+}
 
-  assert(next_id != MAX_U_LONG_INT); //przepełnienie
-  dicts().emplace(next_id, MAPTEL{});
-  if (debug)
-    cerr << "maptel: maptel_create: new map id = " << next_id << "\n"; 
- 
-  return next_id++;
+unsigned long maptel_clone(unsigned long id) {
+  Dict &d = get_dict(id);
+  flush_queue(d);
+  /* wersje są niezmienne, więc kopia współdzieli węzły bieżącej wersji,
+   * ale nowe przydziela z własnej puli, bo z puli d przydziela piszący d */
+  shared_ptr<const Snapshot> source = d.share();
+  unique_ptr<Dict> copy(new Dict);
+  copy->publish(make_shared<Snapshot>(
+    *source, make_shared<Arena>(MAPTEL_HUGEPAGES, source->map.arena())));
+  unsigned long copy_id = add_dict(move(copy));
+  if (tracing)
+    trace(MAPTEL_TRACE_CLONE, id, NULL, NULL, NULL, copy_id);
+  return copy_id;
 }
 
 void maptel_delete(unsigned long id) {
-  if (debug)
-    cerr << "maptel: maptel_delete(" << id << ")\n";
-  auto it = dicts().find(id);
-  assert(it != dicts().end());      // czy istnieje słownik o danym id
-  dicts().erase(it);
-  if (debug)
-    cerr << "maptel: maptel_delete: map " << id << " deleted\n";
+  unique_ptr<Dict> removed = dicts().remove(id); // niszczony poza blokadą
+  if (tracing)
+    trace(MAPTEL_TRACE_DELETE, id);
 }
 
 void maptel_insert(unsigned long id, 
                    char const *tel_src, 
                    char const *tel_dst) {
   
-  if (debug)
-    cerr << "maptel: maptel_insert(" << id << ", "
-         << tel_src << ", " << tel_dst << ")\n";     
-  assert(if_string_correct(tel_src));
-  assert(if_string_correct(tel_dst));
-  string s_src (tel_src);
-  string s_dst (tel_dst);
+  string s_src = read_number(tel_src);
+  string s_dst = read_number(tel_dst);
   assert(!s_src.empty());
   assert(!s_dst.empty());
   
-  auto it_dicts = dicts().find(id);
-  assert(it_dicts != dicts().end()); // czy istnieje słownik o danym id
-  
-  auto it_maptel = it_dicts->second.find(s_src);
-  if (it_maptel != it_dicts->second.end()) { //istnieje zmiana, nadpisuje 
-    it_maptel->second = s_dst; 
-  } else {                                   //nie istnieje, dodaj nowe
-    it_dicts->second.emplace(s_src, s_dst); 
+  Dict &d = get_dict(id);
+  Request r;                         //nadpisuje ewentualną zmianę
+  r.src = move(s_src);
+  r.dst = move(s_dst);
+  d.counters.inserts.fetch_add(1, memory_order_relaxed);
+  if (d.async) {
+    d.async->push(move(r));          // zdarzenie zgłosi wątek zapisu
+    return;
   }
+  apply_now(d, r);
 
-  if (debug)
-    cerr << "maptel: maptel_insert: inserted\n";
+  if (tracing)
+    trace(MAPTEL_TRACE_INSERT, id, tel_src, tel_dst);
 }
 
 void maptel_erase(unsigned long id, char const *tel_src) {
-  if (debug)
-    cerr << "maptel: maptel_erase(" << id << ", " << tel_src << ")\n";
-
-  assert(if_string_correct(tel_src));
-  string s_src (tel_src);
+  string s_src = read_number(tel_src);
   assert(!s_src.empty());
   
-  auto it_dicts = dicts().find(id);
-  assert(it_dicts != dicts().end()); // czy istnieje słownik o danym id
-  
-  auto it_maptel = it_dicts->second.find(s_src);
-  if (it_maptel == it_dicts->second.end()) {
-    if (debug)
-      cerr << "maptel: maptel_erase: nothing to erase\n";
-  } else {
-    it_dicts->second.erase(it_maptel);
-    if (debug)
-      cerr << "maptel: maptel_erase: erased\n";
+  Dict &d = get_dict(id);
+  Request r;
+  r.kind = Request::ERASE;
+  r.src = move(s_src);
+  d.counters.erases.fetch_add(1, memory_order_relaxed);
+  if (d.async) {
+    d.async->push(move(r));          // zdarzenie zgłosi wątek zapisu
+    return;
   }
+  bool erased = apply_now(d, r);
+  
+  if (tracing)
+    trace(MAPTEL_TRACE_ERASE, id, tel_src, NULL, NULL, 0, erased);
 }
 
-void maptel_transform(unsigned long id, char const *tel_src, 
-                      char *tel_dst, size_t len) {
-  if (debug)
-    cerr << "maptel: maptel_transform(" << id << ", "
-         << tel_src << ", " << &tel_dst << ", " << len << ")\n";
+void maptel_insert_prefix(unsigned long id,
+                          char const *prefix_src,
+                          char const *prefix_dst) {
+  string s_src = read_number(prefix_src);
+  string s_dst = read_number(prefix_dst);
+  assert(!s_src.empty());
+  assert(!s_dst.empty());
+
+  Dict &d = get_dict(id);
+  flush_queue(d);
+  update(d, [&](Snapshot &next) {
+    next.trie.set_prefix(s_src, s_dst);
+    return true;
+  });
+  d.counters.inserts.fetch_add(1, memory_order_relaxed);
+
+  if (tracing)
+    trace(MAPTEL_TRACE_INSERT_PREFIX, id, prefix_src, prefix_dst);
+}
+
+void maptel_erase_prefix(unsigned long id, char const *prefix_src) {
+  string s_src = read_number(prefix_src);
+  assert(!s_src.empty());
+
+  Dict &d = get_dict(id);
+  flush_queue(d);
+  bool erased = false;
+  update(d, [&](Snapshot &next) {
+    erased = next.trie.erase_prefix(s_src);
+    return erased;
+  });
+  d.counters.erases.fetch_add(1, memory_order_relaxed);
+
+  if (tracing)
+    trace(MAPTEL_TRACE_ERASE_PREFIX, id, prefix_src, NULL, NULL, 0, erased);
+}
+
+int maptel_transform_bounded(unsigned long id, char const *tel_src, 
+                             char *tel_dst, size_t len) {
   assert(tel_dst != NULL);
-  assert(if_string_correct(tel_src));
   assert(len > 0);
 
-  auto it_dicts = dicts().find(id);
-  assert(it_dicts != dicts().end()); // czy istnieje słownik o danym id
-  
-  string s_src (tel_src);
+  Dict &d = get_dict(id);
+  Number s_src = read_key(tel_src);
   assert(!s_src.empty());
-  string result = find_dst(it_dicts->second, s_src);
-  assert(len > result.length());
+  Number result (s_src);
+  size_t hops;
+  bool truncated;
+  bool cycle;
+  {
+    /* przypięcie kończy się przed trace, bo funkcja śledząca może
+     * zmieniać słownik */
+    Pin snapshot(d);
+    cycle = !find_dst(*snapshot, result, hops,
+                      d.hop_limit.load(memory_order_relaxed), truncated);
+  }
+  if (cycle) {
+    result = s_src;
+    d.counters.cycles.fetch_add(1, memory_order_relaxed);
+  }
+  assert(len > result.size());
+  memcpy(tel_dst, result.c_str(), result.size() + 1);
+  d.counters.transforms.fetch_add(1, memory_order_relaxed);
+  d.counters.hops.fetch_add(hops, memory_order_relaxed);
+  if (truncated)
+    d.counters.truncated.fetch_add(1, memory_order_relaxed);
   
-  if (result.empty()) {
-    strcpy(tel_dst, s_src.c_str());
-    if (debug)
-      cerr << "maptel: maptel_transform: cycle detected\n";
+  if (tracing)
+    trace(MAPTEL_TRACE_TRANSFORM, id, tel_src, tel_dst, NULL, len,
+          truncated ? 2 : cycle);
+  return truncated;
+}
+
+void maptel_transform(unsigned long id, char const *tel_src, 
+                      char *tel_dst, size_t len) {
+  maptel_transform_bounded(id, tel_src, tel_dst, len);
+}
+
+void maptel_set_hop_limit(unsigned long id, size_t limit) {
+  get_dict(id).hop_limit.store(limit, memory_order_relaxed);
+}
+
+int maptel_save(unsigned long id, char const *path) {
+  assert(path != NULL);
+
+  Dict &d = get_dict(id);
+  flush_queue(d);
+  shared_ptr<const Snapshot> snapshot = d.share();
+
+  size_t entries = 0;
+  for_each_entry(*snapshot, [&entries](char const *, char const *) {
+    ++entries;
+  });
+
+  // co najmniej połowa pól wolna, aby ciągi próbkowania były krótkie
+  uint64_t slot_count = 16;
+  while (slot_count < 2 * entries)
+    slot_count *= 2;
+
+  ImageHeader header;
+  memcpy(header.magic, IMAGE_MAGIC, sizeof(IMAGE_MAGIC));
+  header.slot_count = slot_count;
+  header.entry_count = entries;
+  header.prefix_count = snapshot->trie.prefix_count();
+  /* pola wypełniane są wprost w zmapowanym pliku, wyzerowanym przy
+   * jego utworzeniu */
+  auto fill = [&](ImageSlot *slots) {
+    for_each_entry(*snapshot, [&](char const *src, char const *dst) {
+      uint64_t i = image_hash(src) & (slot_count - 1);
+      while (slots[i].src[0] != '\0')
+        i = (i + 1) & (slot_count - 1);
+      strcpy(slots[i].src, src);
+      strcpy(slots[i].dst, dst);
+    });
+    size_t prefix_slot = slot_count;
+    snapshot->trie.for_each_prefix(
+      [&](Number const &prefix_src, Number const &prefix_dst) {
+        strcpy(slots[prefix_slot].src, prefix_src.c_str());
+        strcpy(slots[prefix_slot].dst, prefix_dst.c_str());
+        ++prefix_slot;
+      });
+  };
+
+  int result = write_image(path, header, fill) ? 0 : -1;
+  if (tracing)
+    trace(MAPTEL_TRACE_SAVE, id, NULL, NULL, path, entries, result);
+  return result;
+}
+
+int maptel_load(char const *path, unsigned long *id) {
+  assert(path != NULL);
+  assert(id != NULL);
+
+  shared_ptr<const Image> image = Image::open(path, false);
+  if (!image) {
+    if (tracing)
+      trace(MAPTEL_TRACE_LOAD, 0, NULL, NULL, path, 0, -1);
+    return -1;
+  }
+  *id = maptel_create();
+  update(get_dict(*id), [&image](Snapshot &next) {
+    for (size_t i = 0; i < image->prefix_count(); ++i)
+      next.trie.set_prefix(image->prefix(i).src, image->prefix(i).dst);
+    next.image = move(image);
+    return true;
+  });
+  if (tracing)
+    trace(MAPTEL_TRACE_LOAD, *id, NULL, NULL, path);
+  return 0;
+}
+
+int maptel_load_file(unsigned long id, char const *path) {
+  assert(path != NULL);
+
+  Dict &d = get_dict(id);
+  flush_queue(d);
+  size_t total = 0;
+  int result = -1;
+
+  /* wszystkie pola i tak są czytane, więc sprawdzane od razu */
+  shared_ptr<const Image> image = Image::open(path, true);
+  if (image) {                       // obraz zapisany przez maptel_save
+    update(d, [&](Snapshot &next) {
+      for (size_t i = 0; i < image->slot_count(); ++i) {
+        ImageSlot const &slot = image->slot(i);
+        if (slot.src[0] != '\0') {
+          set_change(d, next, slot.src, slot.dst);
+          ++total;
+        }
+      }
+      for (size_t i = 0; i < image->prefix_count(); ++i)
+        next.trie.set_prefix(image->prefix(i).src, image->prefix(i).dst);
+      return true;
+    });
+    result = 0;
   } else {
-    strcpy(tel_dst, result.c_str());
+    int fd = open(path, O_RDONLY);
+    struct stat st;
+    void *addr = MAP_FAILED;
+    size_t size = 0;
+    if (fd >= 0 && fstat(fd, &st) == 0) {
+      size = st.st_size;
+      if (size == 0)
+        result = 0;
+      else
+        addr = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    }
+    if (fd >= 0)
+      close(fd);
+
+    if (addr != MAP_FAILED) {
+      madvise(addr, size, MADV_SEQUENTIAL);
+      vector<vector<RawPair>> parts;
+      if (parse_pairs_parallel(static_cast<char const *>(addr), size,
+                               parts)) {
+        /* cała partia trafia do jednej nowej wersji - węzły utworzone
+         * w niej są zmieniane w miejscu, a czytający widzą ją dopiero
+         * w całości */
+        update(d, [&](Snapshot &next) {
+          for (auto const &part : parts) {
+            total += part.size();
+            for (auto const &pair : part)
+              set_change(d, next, string(pair.src, pair.src_len),
+                         string(pair.dst, pair.dst_len));
+          }
+          return true;
+        });
+        result = 0;
+      }
+      munmap(addr, size);
+    }
   }
-  
-  if (debug)
-    cerr << "maptel: maptel_transform: "
-         << s_src << " -> " << tel_dst << ", \n";
+  d.counters.inserts.fetch_add(total, memory_order_relaxed);
+
+  if (tracing)
+    trace(MAPTEL_TRACE_LOAD_FILE, id, NULL, NULL, path, total, result);
+  return result;
+}
+
+void maptel_set_trace(maptel_trace_fn fn) {
+  trace_fn().store(fn, memory_order_release);
+}
+
+void maptel_get_stats(unsigned long id, maptel_stats *stats) {
+  assert(stats != NULL);
+
+  Counters const &c = get_dict(id).counters;
+  stats->inserts = c.inserts.load(memory_order_relaxed);
+  stats->erases = c.erases.load(memory_order_relaxed);
+  stats->transforms = c.transforms.load(memory_order_relaxed);
+  stats->cycles = c.cycles.load(memory_order_relaxed);
+  stats->hops = c.hops.load(memory_order_relaxed);
+  stats->truncated = c.truncated.load(memory_order_relaxed);
+  stats->average_chain_length = stats->transforms == 0 ? 0.0 :
+    static_cast<double>(stats->hops) / stats->transforms;
+}
+
+void maptel_set_reverse_index(unsigned long id, int enabled) {
+  Dict &d = get_dict(id);
+  lock_guard<mutex> lock(d.writer);
+  if (!enabled)
+    d.index.reset();
+  else if (!d.index)
+    d.index.reset(new ReverseIndex(*d.current));
+}
+
+long maptel_sources_of(unsigned long id, char const *tel_dst,
+                       maptel_number_fn fn, void *arg) {
+  string s_dst = read_number(tel_dst);
+  assert(fn != NULL);
+
+  Dict &d = get_dict(id);
+  vector<string> found;
+  {
+    lock_guard<mutex> lock(d.writer);
+    assert(d.index);                 // czy indeks odwrotny jest włączony
+    shared_ptr<const Snapshot> const &snapshot = d.current;
+    /* indeks nie opisuje przekształceń przez zmiany prefiksów ani
+     * przerwanych po limicie zmian */
+    if (snapshot->trie.prefix_count() > 0 ||
+        d.hop_limit.load(memory_order_relaxed) > 0)
+      return -1;
+    d.index->sources_of(*snapshot, s_dst, found);
+  }
+  for (string const &src : found)
+    fn(src.c_str(), arg);
+  return found.size();
+}
+
+long maptel_chain_length(unsigned long id, char const *tel_src) {
+  Pin snapshot(get_dict(id));
+  Number s = read_key(tel_src);
+  size_t hops;
+  if (!find_dst(*snapshot, s, hops))
+    return -1;
+  return hops;
+}
+
+long maptel_find_cycles(unsigned long id, maptel_cycle_fn fn, void *arg) {
+  assert(fn != NULL);
+
+  Dict &d = get_dict(id);
+  vector<vector<string>> found;
+  {
+    lock_guard<mutex> lock(d.writer);
+    assert(d.index);                 // czy indeks odwrotny jest włączony
+    if (d.current->trie.prefix_count() > 0)
+      return -1;                     // cykle przez zmiany prefiksów
+    d.index->find_cycles(found);
+  }
+  vector<char const *> tels;
+  for (auto const &cycle : found) {
+    tels.clear();
+    for (string const &tel : cycle)
+      tels.push_back(tel.c_str());
+    fn(tels.data(), tels.size(), arg);
+  }
+  return found.size();
+}
+
+void maptel_set_async(unsigned long id, int enabled) {
+  Dict &d = get_dict(id);
+  if (enabled && !d.async)
+    d.async.reset(new AsyncWriter(d, id));
+  else if (!enabled)
+    d.async.reset();                 // stosuje kolejkę i zatrzymuje wątek
+}
+
+void maptel_flush(unsigned long id) {
+  flush_queue(get_dict(id));
+}
+
+size_t maptel_memory_usage(unsigned long id) {
+  Dict &d = get_dict(id);
+  size_t bytes = sizeof(Dict) + memory_usage(*d.share());
+  lock_guard<mutex> lock(d.writer);
+  if (d.index)
+    bytes += d.index->memory_usage();
+  return bytes;
+}
+
+void maptel_compact(unsigned long id) {
+  Dict &d = get_dict(id);
+  flush_queue(d);
+  update(d, [&d](Snapshot &next) {
+    /* zmiany trafiają najpierw do puli roboczej, a stamtąd, już bez
+     * bloków zwolnionych przy wstawianiu, do nowej puli; stara pula
+     * zniknie razem z ostatnią wersją, która jej używa */
+    Snapshot staging(make_shared<Arena>(MAPTEL_HUGEPAGES));
+    staging.image = next.image;
+    staging.trie_numbers = next.trie_numbers;
+    staging.epoch = next.epoch;
+    /* zostają tylko zmiany różne od obrazu, w tym usunięcia jego wpisów */
+    auto keep = [&](Number const &src, Number const &dst) {
+      char const *base = next.image ? next.image->find(src.c_str()) : NULL;
+      if (base != NULL ? dst != base : !dst.empty())
+        set_number(staging, src, dst);
+    };
+    if (next.trie_numbers)
+      next.trie.for_each_number(keep);
+    else
+      next.map.for_each(keep);
+    next.trie.for_each_prefix(
+      [&staging](Number const &src, Number const &dst) {
+        staging.trie.set_prefix(src, dst);
+      });
+    Snapshot fresh(staging, make_shared<Arena>(MAPTEL_HUGEPAGES));
+    fresh.map.compact();
+    fresh.trie.compact();
+    next = move(fresh);
+    if (d.index)                     // tablice haszujące indeksu nie maleją
+      d.index.reset(new ReverseIndex(next));
+    return true;
+  });
+
+  if (tracing)
+    trace(MAPTEL_TRACE_COMPACT, id, NULL, NULL, NULL,
+          maptel_memory_usage(id));
+}
+
+unsigned long maptel_overlay_create(unsigned long const *ids, size_t count) {
+  assert(ids != NULL || count == 0);
+
+  for (size_t i = 0; i < count; ++i)
+    get_dict(ids[i]);                // czy istnieją słowniki warstw
+  unsigned long id =
+    overlays().add(vector<unsigned long>(ids, ids + count));
+  if (tracing)
+    trace(MAPTEL_TRACE_OVERLAY_CREATE, id, NULL, NULL, NULL, count);
+  return id;
+}
+
+void maptel_overlay_delete(unsigned long overlay) {
+  overlays().remove(overlay);
+  if (tracing)
+    trace(MAPTEL_TRACE_OVERLAY_DELETE, overlay);
+}
+
+int maptel_overlay_transform(unsigned long overlay, char const *tel_src,
+                             char *tel_dst, size_t len) {
+  assert(tel_dst != NULL);
+  assert(len > 0);
+
+  string s = read_number(tel_src);
+  assert(!s.empty());
+  bool truncated = overlays().get(overlay)->transform(s);
+  assert(len > s.length());
+  strcpy(tel_dst, s.c_str());
+
+  if (tracing)
+    trace(MAPTEL_TRACE_OVERLAY_TRANSFORM, overlay, tel_src, tel_dst, NULL,
+          len, truncated);
+  return truncated;
 }
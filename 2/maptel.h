@@ -14,26 +14,246 @@ const size_t TEL_NUM_MAX_LEN = 22;
 /* Tworzy słownik i zwraca liczbę naturalną będącą jego identyfikatorem. */
 unsigned long maptel_create();
 
+/* Tworzy słownik, który zamiast tablicy haszującej przechowuje numery
+ * w skompresowanym drzewie cyfr, zapisując wspólne prefiksy numerów raz,
+ * i zwraca jego identyfikator. */
+unsigned long maptel_create_trie();
+
+/* Tworzy kopię słownika o identyfikatorze id i zwraca jej identyfikator.
+ * Kopia współdzieli wszystkie węzły z oryginałem, więc kosztuje O(1)
+ * niezależnie od wielkości słownika; późniejsza zmiana jednego z nich
+ * kopiuje tylko zmieniane węzły i nie jest widoczna w drugim. Kopia ma
+ * zerowe liczniki, wyłączony indeks odwrotny i tryb zapisu w tle. */
+unsigned long maptel_clone(unsigned long id);
+
 /* Usuwa słownik o identyfikatorze id. */
 void maptel_delete(unsigned long id);
 
 /* Wstawia do słownika o identyfikatorze id informację o zmianie numeru
- * tel_src na numer tel_dst. Nadpisuje ewentualną istniejącą informację. */
+ * tel_src na numer tel_dst. Nadpisuje ewentualną istniejącą informację.
+ * Poza trybem zapisu w tle każde wywołanie publikuje nową wersję
+ * słownika, aby równoległe maptel_transform nie czekały: kopiuje węzły
+ * na ścieżce od korzenia do zmiany, w tablicy haszującej po jednym
+ * na każde 5 bitów haszu, więc kosztuje kilka razy więcej niż zmiana
+ * zwykłej tablicy haszującej w miejscu. Poprzednią wersję zwalnia
+ * dopiero po zakończeniu maptel_transform, które mogły ją czytać.
+ * Wywołania z kilku wątków naraz są stosowane razem, w jednej wersji.
+ * Wiele zmian naraz taniej wstawiają maptel_load_file i tryb zapisu
+ * w tle, które budują jedną wersję na całą partię zmian. */
 void maptel_insert(unsigned long id, char const *tel_src, 
                    char const *tel_dst);
 
 /* Jeśli w słowniku o identyfikatorze id jest informacja o zmianie numeru
- * tel_src, to ją usuwa. W przeciwnym przypadku nic nie robi. */
+ * tel_src, to ją usuwa. W przeciwnym przypadku nic nie robi. Kosztuje
+ * tyle co maptel_insert. */
 void maptel_erase(unsigned long id, char const *tel_src);
 
+/* Wstawia do słownika o identyfikatorze id informację o zmianie wszystkich
+ * numerów zaczynających się od prefix_src: w takim numerze prefiks
+ * prefix_src jest zastępowany przez prefix_dst. Zmiana konkretnego numeru
+ * ma pierwszeństwo przed zmianą prefiksu, a spośród zmian prefiksów
+ * stosowana jest najdłuższa pasująca. Zmiana, po której numer byłby
+ * dłuższy niż TEL_NUM_MAX_LEN, nie jest stosowana. Nadpisuje ewentualną
+ * istniejącą zmianę prefiksu prefix_src. */
+void maptel_insert_prefix(unsigned long id, char const *prefix_src,
+                          char const *prefix_dst);
+
+/* Usuwa ze słownika o identyfikatorze id zmianę prefiksu prefix_src,
+ * jeśli taka jest. */
+void maptel_erase_prefix(unsigned long id, char const *prefix_src);
+
 /* Sprawdza, czy w słowniku o identyfikatorze id jest zapisana zmiana numeru
  * tel_src. Podąża ciągiem kolejnych zmian. Zapisuje zmieniony numer w tel_dst.
  * Jeśli nie ma zmiany numeru lub zmiany tworzą cykl, to zapisuje w tel_dst
  * numer tel_src. Wartość len to wielkość przydzielonej pamięci wskazywanej
- * przez tel_dst. */
+ * przez tel_dst. Podąża zmianami w jednej, spójnej wersji słownika i nie
+ * czeka na równolegle wykonywane zmiany słownika: nie bierze blokady,
+ * a wersję przypina kilkoma operacjami atomowymi. Każda zmiana w ciągu
+ * to wyszukanie w trwałej tablicy haszującej, przechodzące przez kilka
+ * zależnych od siebie węzłów, więc w dużym słowniku przekształcenie
+ * trwa dłużej niż w zwykłej tablicy haszującej (około 1,4 razy przy
+ * 4 mln wpisów). Jeśli słownik ma limit zmian (maptel_set_hop_limit), to
+ * po jego osiągnięciu zapisuje w tel_dst numer osiągnięty do tej chwili. */
 void maptel_transform(unsigned long id, char const *tel_src, 
                       char *tel_dst, size_t len);
 
+/* Działa tak jak maptel_transform i zwraca 1, jeśli przekształcenie
+ * przerwano po osiągnięciu limitu zmian, a 0 w przeciwnym przypadku. */
+int maptel_transform_bounded(unsigned long id, char const *tel_src,
+                             char *tel_dst, size_t len);
+
+/* Ustawia największą liczbę zmian, którymi podąża przekształcenie numeru
+ * w słowniku o identyfikatorze id, co ogranicza czas jednego wywołania
+ * maptel_transform. Wartość 0 (domyślna) oznacza brak limitu. */
+void maptel_set_hop_limit(unsigned long id, size_t limit);
+
+/* Zapisuje słownik o identyfikatorze id do pliku path jako obraz tablicy
+ * haszującej, który maptel_load może zmapować do pamięci bez przebudowy.
+ * Tablica jest wypełniana wprost w zmapowanym pliku, bez kopii
+ * w pamięci procesu.
+ * Zwraca 0, jeśli zapis się powiódł, a -1 w przeciwnym przypadku. */
+int maptel_save(unsigned long id, char const *path);
+
+/* Tworzy słownik z obrazu zapisanego przez maptel_save i zapisuje jego
+ * identyfikator w *id. Obraz jest mapowany do pamięci tylko do odczytu,
+ * późniejsze zmiany słownika nie modyfikują pliku. Przy wczytaniu
+ * sprawdzane są tylko nagłówek, wielkość pliku i zmiany prefiksów, więc
+ * czas wczytania nie zależy od wielkości obrazu. Pole tablicy jest
+ * sprawdzane, gdy dotrze do niego wyszukiwanie; pole z numerem bez '\0'
+ * albo ze znakiem innym niż cyfra jest traktowane jak brak wpisu.
+ * Zwraca 0, jeśli wczytanie się powiodło, a -1 w przeciwnym przypadku. */
+int maptel_load(char const *path, unsigned long *id);
+
+/* Wstawia do słownika o identyfikatorze id wszystkie zmiany numerów z pliku
+ * path. Plik jest tekstowy, każda linia zawiera numer źródłowy i docelowy
+ * rozdzielone spacjami lub tabulatorami, albo jest obrazem zapisanym przez
+ * maptel_save. Późniejsze linie nadpisują wcześniejsze. Jeśli plik zawiera
+ * niepoprawną linię lub uszkodzone pole obrazu, słownik nie jest
+ * zmieniany.
+ * Zwraca 0, jeśli wczytanie się powiodło, a -1 w przeciwnym przypadku. */
+int maptel_load_file(unsigned long id, char const *path);
+
+/* Rodzaj operacji opisanej zdarzeniem śledzenia */
+enum maptel_trace_kind {
+  MAPTEL_TRACE_CREATE,
+  MAPTEL_TRACE_DELETE,
+  MAPTEL_TRACE_INSERT,
+  MAPTEL_TRACE_ERASE,
+  MAPTEL_TRACE_TRANSFORM,
+  MAPTEL_TRACE_SAVE,
+  MAPTEL_TRACE_LOAD,
+  MAPTEL_TRACE_LOAD_FILE,
+  MAPTEL_TRACE_INSERT_PREFIX,
+  MAPTEL_TRACE_ERASE_PREFIX,
+  MAPTEL_TRACE_COMPACT,
+  MAPTEL_TRACE_CLONE,
+  MAPTEL_TRACE_OVERLAY_CREATE,
+  MAPTEL_TRACE_OVERLAY_DELETE,
+  MAPTEL_TRACE_OVERLAY_TRANSFORM
+};
+
+/* Zdarzenie śledzenia, zgłaszane po zakończeniu operacji. Zdarzenia
+ * wstawiania i usuwania zmian zleconych w trybie zapisu w tle zgłasza
+ * wątek zapisu, dopiero gdy zmiana jest widoczna dla maptel_transform.
+ * Pola, które nie dotyczą danej operacji, są równe NULL lub 0. Wartość
+ * result to: dla usuwania 1, jeśli zmiana została usunięta; dla
+ * przekształcenia 1, jeśli zmiany tworzą cykl, a 2, jeśli przerwano je
+ * po limicie zmian;
+ * dla przekształcenia przez widok 1, jeśli przerwano je po limicie
+ * zmian; dla zapisu i wczytywania wynik funkcji. */
+struct maptel_trace_event {
+  enum maptel_trace_kind kind;
+  unsigned long id;
+  char const *tel_src;
+  char const *tel_dst;
+  char const *path;
+  size_t count;                      /* len, liczba wpisów, bajtów
+                                        lub identyfikator kopii */
+  int result;
+};
+
+typedef void (*maptel_trace_fn)(struct maptel_trace_event const *event);
+
+/* Ustawia funkcję, której przekazywane są zdarzenia śledzenia. Wartość
+ * NULL przywraca domyślne wypisywanie na standardowe wyjście błędów.
+ * Zdarzenia są zgłaszane tylko wtedy, gdy moduł skompilowano ze śledzeniem
+ * (MAPTEL_TRACE, domyślnie włączone bez NDEBUG), w przeciwnym przypadku
+ * śledzenie nie kosztuje nic. */
+void maptel_set_trace(maptel_trace_fn fn);
+
+/* Liczniki operacji wykonanych na słowniku od jego utworzenia */
+struct maptel_stats {
+  unsigned long long inserts;        /* wstawione zmiany */
+  unsigned long long erases;         /* wywołania maptel_erase */
+  unsigned long long transforms;     /* wywołania maptel_transform */
+  unsigned long long cycles;         /* przekształcenia zakończone cyklem */
+  unsigned long long hops;           /* suma długości przebytych ciągów */
+  unsigned long long truncated;      /* przekształcenia przerwane limitem */
+  double average_chain_length;       /* hops / transforms */
+};
+
+/* Zapisuje w *stats liczniki słownika o identyfikatorze id. */
+void maptel_get_stats(unsigned long id, struct maptel_stats *stats);
+
+typedef void (*maptel_number_fn)(char const *tel, void *arg);
+typedef void (*maptel_cycle_fn)(char const *const *tels, size_t count,
+                                void *arg);
+
+/* Włącza (enabled != 0) lub wyłącza indeks odwrotny słownika o
+ * identyfikatorze id. Włączenie buduje indeks w czasie liniowym względem
+ * wielkości słownika, później jest on uaktualniany przy każdej zmianie.
+ * Indeks uwzględnia tylko zmiany numerów, bez zmian prefiksów. */
+void maptel_set_reverse_index(unsigned long id, int enabled);
+
+/* Wywołuje fn(tel_src, arg) dla każdego numeru tel_src, który
+ * maptel_transform zmienia na tel_dst, i zwraca liczbę takich numerów.
+ * Indeks odwrotny zna tylko zmiany całych numerów, więc jeśli słownik
+ * zawiera zmiany prefiksów lub ma limit zmian, nie wywołuje fn i zwraca
+ * -1. Wymaga włączonego indeksu odwrotnego, działa w czasie
+ * proporcjonalnym do wielkości odpowiedzi. */
+long maptel_sources_of(unsigned long id, char const *tel_dst,
+                       maptel_number_fn fn, void *arg);
+
+/* Zwraca liczbę zmian, którymi podąża maptel_transform dla numeru tel_src,
+ * lub -1, jeśli zmiany tworzą cykl. */
+long maptel_chain_length(unsigned long id, char const *tel_src);
+
+/* Wywołuje fn(tels, count, arg) dla każdego cyklu zmian w słowniku
+ * o identyfikatorze id, gdzie tels to kolejne numery cyklu, i zwraca
+ * liczbę cykli. Cykl może przechodzić przez zmianę prefiksu, której
+ * indeks odwrotny nie zna, więc jeśli słownik zawiera zmiany prefiksów,
+ * nie wywołuje fn i zwraca -1. Cykle są zgłaszane niezależnie od limitu
+ * zmian. Wymaga włączonego indeksu odwrotnego. */
+long maptel_find_cycles(unsigned long id, maptel_cycle_fn fn, void *arg);
+
+/* Włącza (enabled != 0) lub wyłącza tryb zapisu w tle słownika
+ * o identyfikatorze id. W tym trybie maptel_insert i maptel_erase tylko
+ * zlecają zmianę i wracają od razu, a osobny wątek stosuje zlecone zmiany
+ * w kolejności zlecenia, partiami. maptel_transform i pozostałe zapytania
+ * mogą nie widzieć jeszcze niezastosowanych zmian. Pozostałe operacje
+ * zmieniające słownik, maptel_save i wyłączenie trybu najpierw stosują
+ * wszystkie zlecone zmiany. Nie może być wywoływana równolegle z innymi
+ * operacjami na tym słowniku. */
+void maptel_set_async(unsigned long id, int enabled);
+
+/* Czeka, aż zostaną zastosowane wszystkie zmiany słownika o identyfikatorze
+ * id zlecone przed wywołaniem. Poza trybem zapisu w tle nic nie robi. */
+void maptel_flush(unsigned long id);
+
+/* Zwraca szacowaną liczbę bajtów, które zajmuje słownik o identyfikatorze
+ * id: całą pulę węzłów wraz z ich numerami, także węzłów starszych
+ * wersji trzymanych jeszcze przez czytających i bloków zwolnionych do
+ * ponownego użycia, zmapowany obraz i indeks odwrotny. Pula współdzielona
+ * z innym słownikiem jest liczona w każdym z nich. */
+size_t maptel_memory_usage(unsigned long id);
+
+/* Przebudowuje słownik o identyfikatorze id tak, aby zajmował tylko tyle
+ * pamięci, ile potrzebuje: usuwa zbędne wpisy przesłaniające obraz, kopiuje
+ * węzły do tablic o dokładnym rozmiarze w nowej puli pamięci i odbudowuje
+ * indeks odwrotny. Stara pula jest zwalniana, gdy przestaną jej używać
+ * czytający starsze wersje i kopie słownika. Nie zmienia wyniku żadnego
+ * zapytania. */
+void maptel_compact(unsigned long id);
+
+/* Tworzy widok warstwowy ze słowników o identyfikatorach ids[0..count)
+ * i zwraca jego identyfikator, niezależny od identyfikatorów słowników.
+ * Słowniki warstw muszą istnieć tak długo jak widok. */
+unsigned long maptel_overlay_create(unsigned long const *ids, size_t count);
+
+/* Usuwa widok warstwowy o identyfikatorze overlay. Słowniki warstw
+ * pozostają. */
+void maptel_overlay_delete(unsigned long overlay);
+
+/* Przekształca numer tel_src kolejno przez słowniki warstw widoku overlay,
+ * w kolejności ids, tak jak kolejne wywołania maptel_transform, i zapisuje
+ * wynik w tel_dst. Wyniki przekształceń w każdej warstwie są pamiętane
+ * i ponownie używane, dopóki nie zmieni się słownik tej warstwy ani jego
+ * limit zmian.
+ * Zwraca 1, jeśli w którejś warstwie przekroczono limit zmian, a 0
+ * w przeciwnym przypadku. */
+int maptel_overlay_transform(unsigned long overlay, char const *tel_src,
+                             char *tel_dst, size_t len);
+
 #ifdef __cplusplus
   }
 #endif
@@ -0,0 +1,316 @@
+/* Test wydajności i obciążeniowy słowników maptel.
+ *
+ * Buduje słownik z ciągów zmian o losowej długości (część z nich tworzy
+ * cykle), mierzy przepustowość oraz opóźnienia p50/p99 operacji insert,
+ * transform i erase w jednym wątku i w wielu wątkach, także przy
+ * równoległych odczytach, oraz sprawdza, że maptel_transform daje
+ * poprawne wyniki podczas równoległych zmian słownika. Wyniki wypisywane
+ * są jako wiersze JSON.
+ *
+ * Użycie: maptel_bench [--entries=N] [--threads=T] [--chain=L]
+ *                      [--cycles=P] [--ops=K] [--backend=hash|trie]
+ *                      [--async] [--seed=S] [--output=plik]
+ *
+ * Z --async zmiany są stosowane w tle (maptel_set_async), a faza
+ * insert_flush mierzy czas oczekiwania na zastosowanie kolejki. */
+
+#include "maptel.h"
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace std;
+using Clock = chrono::steady_clock;
+
+namespace {
+  struct Options {
+    size_t entries = 100000;
+    size_t threads = 4;
+    double chain = 3.0;              // średnia długość ciągu zmian
+    double cycles = 0.01;            // odsetek ciągów zamkniętych w cykl
+    size_t ops = 1000000;            // operacji na fazę pomiaru
+    bool trie = false;
+    bool async = false;
+    unsigned seed = 2015;
+    string output;
+  };
+
+  /* Zmiana numeru wraz z oczekiwanym wynikiem maptel_transform */
+  struct Entry {
+    string src;
+    string dst;
+    string end;
+  };
+
+  struct Result {
+    string phase;
+    size_t threads;
+    size_t ops;
+    double seconds;
+    uint64_t p50_ns;
+    uint64_t p99_ns;
+  };
+
+  bool parse_option(char const *arg, char const *name, string &value) {
+    size_t len = strlen(name);
+    if (strncmp(arg, name, len) != 0 || arg[len] != '=')
+      return false;
+    value = arg + len + 1;
+    return true;
+  }
+
+  Options parse_options(int argc, char **argv) {
+    Options o;
+    for (int i = 1; i < argc; ++i) {
+      string v;
+      if (parse_option(argv[i], "--entries", v))
+        o.entries = stoull(v);
+      else if (parse_option(argv[i], "--threads", v))
+        o.threads = max<size_t>(1, stoull(v));
+      else if (parse_option(argv[i], "--chain", v))
+        o.chain = max(1.0, stod(v));
+      else if (parse_option(argv[i], "--cycles", v))
+        o.cycles = stod(v);
+      else if (parse_option(argv[i], "--ops", v))
+        o.ops = stoull(v);
+      else if (parse_option(argv[i], "--backend", v))
+        o.trie = v == "trie";
+      else if (strcmp(argv[i], "--async") == 0)
+        o.async = true;
+      else if (parse_option(argv[i], "--seed", v))
+        o.seed = stoul(v);
+      else if (parse_option(argv[i], "--output", v))
+        o.output = v;
+      else {
+        cerr << "unknown option " << argv[i] << "\n";
+        exit(1);
+      }
+    }
+    return o;
+  }
+
+  /* Numer o stałej długości, wspólny prefiks jak u numerów operatora */
+  string number(size_t i) {
+    char buf[TEL_NUM_MAX_LEN + 1];
+    snprintf(buf, sizeof(buf), "48%011zu", i);
+    return buf;
+  }
+
+  /* Dzieli numery na ciągi zmian o długości z rozkładu geometrycznego
+   * o średniej o.chain, część z nich zamyka w cykl */
+  vector<Entry> make_entries(Options const &o, mt19937_64 &rng) {
+    geometric_distribution<size_t> length(1.0 / o.chain);
+    bernoulli_distribution cycle(o.cycles);
+    vector<Entry> entries;
+    entries.reserve(o.entries);
+    size_t next = 0;
+    while (entries.size() < o.entries) {
+      size_t len = min(1 + length(rng), o.entries - entries.size());
+      size_t first = next;
+      bool closed = len > 1 && cycle(rng);
+      string end = closed ? "" : number(first + len);
+      for (size_t i = 0; i < len; ++i) {
+        string src = number(first + i);
+        string dst = closed && i + 1 == len ? number(first)
+                                            : number(first + i + 1);
+        entries.push_back(Entry{src, dst, closed ? src : end});
+      }
+      next += len + 1;               // koniec ciągu nie ma zmiany
+    }
+    shuffle(entries.begin(), entries.end(), rng);
+    return entries;
+  }
+
+  uint64_t percentile(vector<uint64_t> &lat, double p) {
+    if (lat.empty())
+      return 0;
+    size_t k = min(lat.size() - 1, static_cast<size_t>(p * lat.size()));
+    nth_element(lat.begin(), lat.begin() + k, lat.end());
+    return lat[k];
+  }
+
+  /* Uruchamia op(wątek, i) dla ops operacji rozdzielonych między threads
+   * wątków i mierzy czas każdej z nich */
+  template <typename F>
+  Result measure(string const &phase, size_t threads, size_t ops, F op) {
+    vector<vector<uint64_t>> lat(threads);
+    vector<thread> workers;
+    auto start = Clock::now();
+    for (size_t t = 0; t < threads; ++t) {
+      workers.emplace_back([&, t]() {
+        size_t begin = ops * t / threads, end = ops * (t + 1) / threads;
+        lat[t].reserve(end - begin);
+        for (size_t i = begin; i < end; ++i) {
+          auto before = Clock::now();
+          op(t, i);
+          lat[t].push_back(chrono::duration_cast<chrono::nanoseconds>(
+            Clock::now() - before).count());
+        }
+      });
+    }
+    for (auto &w : workers)
+      w.join();
+    double seconds = chrono::duration<double>(Clock::now() - start).count();
+
+    vector<uint64_t> all;
+    all.reserve(ops);
+    for (auto const &l : lat)
+      all.insert(all.end(), l.begin(), l.end());
+    return Result{phase, threads, ops, seconds, percentile(all, 0.5),
+                  percentile(all, 0.99)};
+  }
+
+  void report(ostream &out, Options const &o, Result const &r) {
+    out << "{\"phase\":\"" << r.phase << "\""
+        << ",\"backend\":\"" << (o.trie ? "trie" : "hash") << "\""
+        << ",\"async\":" << (o.async ? "true" : "false")
+        << ",\"entries\":" << o.entries
+        << ",\"chain\":" << o.chain
+        << ",\"cycles\":" << o.cycles
+        << ",\"threads\":" << r.threads
+        << ",\"ops\":" << r.ops
+        << ",\"seconds\":" << r.seconds
+        << ",\"ops_per_sec\":" << (r.seconds > 0 ? r.ops / r.seconds : 0)
+        << ",\"p50_ns\":" << r.p50_ns
+        << ",\"p99_ns\":" << r.p99_ns << "}\n";
+    out.flush();
+  }
+
+  unsigned long create(Options const &o) {
+    unsigned long id = o.trie ? maptel_create_trie() : maptel_create();
+    if (o.async)
+      maptel_set_async(id, 1);
+    return id;
+  }
+
+  void check_transform(unsigned long id, Entry const &e) {
+    char buf[TEL_NUM_MAX_LEN + 1];
+    maptel_transform(id, e.src.c_str(), buf, sizeof(buf));
+    if (e.end != buf) {
+      cerr << "maptel_transform(" << e.src << ") = " << buf
+           << ", expected " << e.end << "\n";
+      abort();
+    }
+  }
+}
+
+int main(int argc, char **argv) {
+  Options o = parse_options(argc, argv);
+  mt19937_64 rng(o.seed);
+  vector<Entry> entries = make_entries(o, rng);
+
+  ofstream file;
+  if (!o.output.empty())
+    file.open(o.output.c_str(), ios::app);
+  ostream &out = o.output.empty() ? cout : file;
+
+  unsigned long id = create(o);
+  report(out, o, measure("insert", 1, entries.size(),
+    [&](size_t, size_t i) {
+      maptel_insert(id, entries[i].src.c_str(), entries[i].dst.c_str());
+    }));
+  if (o.async)
+    report(out, o, measure("insert_flush", 1, 1,
+      [&](size_t, size_t) { maptel_flush(id); }));
+
+  for (size_t threads : {static_cast<size_t>(1), o.threads}) {
+    report(out, o, measure("transform", threads, o.ops,
+      [&](size_t, size_t i) {
+        char buf[TEL_NUM_MAX_LEN + 1];
+        Entry const &e = entries[i * 7919 % entries.size()];
+        maptel_transform(id, e.src.c_str(), buf, sizeof(buf));
+      }));
+  }
+
+  /* Obciążenie: jeden wątek nadpisuje zmiany tymi samymi wartościami
+   * i wstawia oraz usuwa zmiany spoza ciągów, pozostałe sprawdzają, że
+   * wynik maptel_transform się nie zmienia */
+  if (o.threads > 1) {
+    atomic<bool> stop(false);
+    size_t writes = 0;
+    thread writer([&]() {
+      while (!stop.load()) {
+        Entry const &e = entries[writes % entries.size()];
+        maptel_insert(id, e.src.c_str(), e.dst.c_str());
+        string other = number(o.entries * 3 + writes % 1000);
+        maptel_insert(id, other.c_str(), e.src.c_str());
+        maptel_erase(id, other.c_str());
+        ++writes;
+      }
+    });
+    report(out, o, measure("transform_under_writes", o.threads - 1, o.ops,
+      [&](size_t, size_t i) {
+        check_transform(id, entries[i * 7919 % entries.size()]);
+      }));
+    stop = true;
+    writer.join();
+  }
+
+  for (size_t i = 0; i < min<size_t>(entries.size(), 10000); ++i)
+    check_transform(id, entries[i]);
+
+  maptel_stats stats;
+  maptel_get_stats(id, &stats);
+  out << "{\"phase\":\"stats\",\"transforms\":" << stats.transforms
+      << ",\"cycles\":" << stats.cycles
+      << ",\"average_chain_length\":" << stats.average_chain_length
+      << "}\n";
+
+  report(out, o, measure("erase", 1, entries.size(),
+    [&](size_t, size_t i) {
+      maptel_erase(id, entries[i].src.c_str());
+    }));
+  maptel_delete(id);
+
+  /* Zapis z o.threads wątków do nowego słownika, bez odczytów i podczas
+   * odczytów jednego wątku, który bez przerwy wywołuje maptel_transform */
+  if (o.threads > 1) {
+    for (bool reads : {false, true}) {
+      string suffix = reads ? "_under_reads" : "";
+      unsigned long shared = create(o);
+      atomic<bool> stop(false);
+      thread reader;
+      if (reads)
+        reader = thread([&]() {
+          char buf[TEL_NUM_MAX_LEN + 1];
+          for (size_t i = 0; !stop.load(); ++i)
+            maptel_transform(shared,
+                             entries[i * 7919 % entries.size()].src.c_str(),
+                             buf, sizeof(buf));
+        });
+
+      report(out, o, measure("insert" + suffix, o.threads, entries.size(),
+        [&](size_t, size_t i) {
+          maptel_insert(shared, entries[i].src.c_str(),
+                        entries[i].dst.c_str());
+        }));
+      maptel_flush(shared);
+      for (size_t i = 0; i < min<size_t>(entries.size(), 10000); ++i)
+        check_transform(shared, entries[i]);
+
+      report(out, o, measure("erase" + suffix, o.threads, entries.size(),
+        [&](size_t, size_t i) {
+          maptel_erase(shared, entries[i].src.c_str());
+        }));
+      maptel_flush(shared);
+      for (size_t i = 0; i < min<size_t>(entries.size(), 10000); ++i)
+        check_transform(shared, Entry{entries[i].src, "", entries[i].src});
+
+      stop = true;
+      if (reads)
+        reader.join();
+      maptel_delete(shared);
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,620 @@
+/* Testy słowników maptel */
+
+#include "maptel.h"
+#include <cassert>
+#include <cstdio>
+#include <cstring>
+#include <algorithm>
+#include <atomic>
+#include <fstream>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+#include <unistd.h>
+using namespace std;
+
+string transform(unsigned long id, char const *tel_src) {
+  char tel_dst[TEL_NUM_MAX_LEN + 1];
+  maptel_transform(id, tel_src, tel_dst, sizeof(tel_dst));
+  return tel_dst;
+}
+
+/* Ścieżka pliku tymczasowego, niepowtarzalna dla procesu */
+string temp_path(char const *name) {
+  return "/tmp/maptel_test_" + to_string(getpid()) + "_" + name;
+}
+
+void write_file(string const &path, string const &content) {
+  ofstream out(path.c_str(), ios::binary);
+  out << content;
+}
+
+string read_file(string const &path) {
+  ifstream in(path.c_str(), ios::binary);
+  return string(istreambuf_iterator<char>(in), istreambuf_iterator<char>());
+}
+
+/* Biblioteka testowana jest z asercjami i ze śledzeniem, zdarzenia nie
+ * zaśmiecają jednak wyjścia */
+void ignore_trace(maptel_trace_event const *) {}
+
+void basic_operations() {
+  unsigned long id = maptel_create();
+  assert(transform(id, "123") == "123");
+  maptel_insert(id, "123", "456");
+  maptel_insert(id, "456", "789");
+  assert(transform(id, "123") == "789");
+  maptel_insert(id, "456", "000");
+  assert(transform(id, "123") == "000");
+  maptel_erase(id, "456");
+  assert(transform(id, "123") == "456");
+  maptel_erase(id, "999");
+  maptel_insert(id, "456", "123");   // cykl zostawia numer bez zmian
+  assert(transform(id, "123") == "123");
+
+  maptel_stats stats;
+  maptel_get_stats(id, &stats);
+  assert(stats.inserts == 4);
+  assert(stats.erases == 2);
+  assert(stats.transforms == 5);
+  assert(stats.cycles == 1);
+  maptel_delete(id);
+}
+
+void save_and_load() {
+  string path = temp_path("image");
+  unsigned long id = maptel_create();
+  for (int i = 0; i < 1000; ++i)
+    maptel_insert(id, to_string(1000000 + i).c_str(),
+                  to_string(2000000 + i).c_str());
+  maptel_insert(id, "2000000", "3");
+  maptel_insert_prefix(id, "77", "88");
+  assert(maptel_save(id, path.c_str()) == 0);
+
+  unsigned long loaded;
+  assert(maptel_load(path.c_str(), &loaded) == 0);
+  for (int i = 0; i < 1000; ++i)
+    assert(transform(loaded, to_string(1000000 + i).c_str()) ==
+           transform(id, to_string(1000000 + i).c_str()));
+  assert(transform(loaded, "1000000") == "3");
+  assert(transform(loaded, "7712") == "8812");
+  assert(transform(loaded, "5") == "5");
+
+  /* zmiany wczytanego słownika przesłaniają obraz, nie zmieniając pliku */
+  maptel_erase(loaded, "1000001");
+  maptel_insert(loaded, "1000002", "4");
+  assert(transform(loaded, "1000001") == "1000001");
+  assert(transform(loaded, "1000002") == "4");
+  unsigned long again;
+  assert(maptel_load(path.c_str(), &again) == 0);
+  assert(transform(again, "1000001") == "2000001");
+
+  /* ponowny zapis uwzględnia zarówno obraz, jak i zmiany */
+  string resaved = temp_path("resaved");
+  assert(maptel_save(loaded, resaved.c_str()) == 0);
+  unsigned long reloaded;
+  assert(maptel_load(resaved.c_str(), &reloaded) == 0);
+  assert(transform(reloaded, "1000001") == "1000001");
+  assert(transform(reloaded, "1000002") == "4");
+  assert(transform(reloaded, "1000003") == "2000003");
+
+  maptel_delete(reloaded);
+  maptel_delete(again);
+  maptel_delete(loaded);
+  maptel_delete(id);
+  remove(resaved.c_str());
+  remove(path.c_str());
+}
+
+/* Uszkodzenie nagłówka, wielkości pliku lub zmiany prefiksu wykrywa
+ * maptel_load, a uszkodzone pole tablicy - wyszukiwanie, które do niego
+ * dotrze, i maptel_load_file */
+void corrupt_images() {
+  string path = temp_path("image");
+  string corrupt = temp_path("corrupt");
+  unsigned long id = maptel_create();
+  maptel_insert(id, "123", "456");
+  maptel_insert_prefix(id, "77", "88");
+  assert(maptel_save(id, path.c_str()) == 0);
+  string image = read_file(path);
+  unsigned long loaded;
+
+  auto rejected = [&](string const &content) {
+    write_file(corrupt, content);
+    return maptel_load(corrupt.c_str(), &loaded) == -1;
+  };
+  /* wczytuje się, ale uszkodzonego wpisu "123" nie widać */
+  auto entry_ignored = [&](string const &content) {
+    write_file(corrupt, content);
+    if (maptel_load(corrupt.c_str(), &loaded) != 0)
+      return false;
+    bool ignored = transform(loaded, "123") == "123" &&
+                   transform(loaded, "775") == "885";
+    maptel_delete(loaded);
+    return ignored && maptel_load_file(id, corrupt.c_str()) == -1;
+  };
+  assert(!rejected(image));
+  assert(transform(loaded, "123") == "456");
+  maptel_delete(loaded);
+
+  assert(rejected(""));
+  assert(rejected(image.substr(0, 16)));
+  assert(rejected(image + '\0'));
+  assert(rejected(image.substr(0, image.size() - 1)));
+  string bad = image;
+  bad[0] = 'X';                      // nagłówek
+  assert(rejected(bad));
+
+  size_t src = image.find("123"), dst = image.find("456");
+  size_t prefix = image.find("88");
+  assert(src != string::npos && dst != string::npos &&
+         prefix != string::npos);
+  bad = image;
+  bad[prefix + 1] = '-';             // zmiana prefiksu
+  assert(rejected(bad));
+  bad = image;
+  bad[dst + 1] = 'x';                // znak inny niż cyfra
+  assert(entry_ignored(bad));
+  bad = image;
+  bad.replace(dst, TEL_NUM_MAX_LEN + 1, TEL_NUM_MAX_LEN + 1, '1');
+  assert(entry_ignored(bad));        // brak '\0' w polu
+  bad = image;
+  bad[dst] = '\0';                   // pusty numer docelowy
+  assert(entry_ignored(bad));
+  bad = image;
+  bad.replace(src, TEL_NUM_MAX_LEN + 1, TEL_NUM_MAX_LEN + 1, '1');
+  assert(entry_ignored(bad));        // numer źródłowy bez '\0'
+  bad = image;
+  bad.replace(src, TEL_NUM_MAX_LEN + 1, TEL_NUM_MAX_LEN + 1, '\0');
+  bad.replace(dst, 3, 3, '\0');
+  assert(entry_ignored(bad));        // liczba wpisów różna od nagłówka
+  assert(transform(id, "123") == "456");
+
+  maptel_delete(id);
+  remove(corrupt.c_str());
+  remove(path.c_str());
+}
+
+void load_file() {
+  string path = temp_path("text");
+  unsigned long id = maptel_create();
+  maptel_insert(id, "999", "1");
+
+  write_file(path, "123 456\n\n  456\t789  \r\n123 111\n555 666");
+  assert(maptel_load_file(id, path.c_str()) == 0);
+  assert(transform(id, "123") == "111");   // późniejsza linia nadpisuje
+  assert(transform(id, "456") == "789");
+  assert(transform(id, "555") == "666");
+  assert(transform(id, "999") == "1");
+
+  /* niepoprawna linia - słownik bez zmian */
+  char const *invalid[] = {
+    "100 200\n300\n", "100 2x0\n", "100 200 300\n", "-100 200\n",
+    "100 12345678901234567890123\n"
+  };
+  for (char const *content : invalid) {
+    write_file(path, content);
+    assert(maptel_load_file(id, path.c_str()) == -1);
+    assert(transform(id, "100") == "100");
+  }
+  assert(maptel_load_file(id, temp_path("missing").c_str()) == -1);
+
+  write_file(path, "");
+  assert(maptel_load_file(id, path.c_str()) == 0);
+
+  /* obraz zapisany przez maptel_save */
+  unsigned long other = maptel_create();
+  maptel_insert(other, "111", "222");
+  assert(maptel_save(other, path.c_str()) == 0);
+  assert(maptel_load_file(id, path.c_str()) == 0);
+  assert(transform(id, "123") == "222");
+
+  /* duży plik jest parsowany kawałkami, kolejność linii zostaje */
+  string big;
+  for (int i = 0; i < 200000; ++i)
+    big += to_string(10000000 + i % 1000) + " " + to_string(i) + "\n";
+  write_file(path, big);
+  assert(maptel_load_file(other, path.c_str()) == 0);
+  for (int i = 0; i < 1000; ++i)
+    assert(transform(other, to_string(10000000 + i).c_str()) ==
+           to_string(199000 + i));
+
+  maptel_delete(other);
+  maptel_delete(id);
+  remove(path.c_str());
+}
+
+void collect(char const *tel, void *arg) {
+  static_cast<set<string> *>(arg)->insert(tel);
+}
+
+void collect_cycle(char const *const *tels, size_t count, void *arg) {
+  static_cast<vector<set<string>> *>(arg)->emplace_back(tels, tels + count);
+}
+
+void reverse_index() {
+  unsigned long id = maptel_create();
+  maptel_insert(id, "1", "2");
+  maptel_insert(id, "2", "3");
+  maptel_insert(id, "4", "3");
+  maptel_insert(id, "5", "6");
+  maptel_insert(id, "6", "5");
+  maptel_set_reverse_index(id, 1);
+
+  set<string> sources;
+  assert(maptel_sources_of(id, "3", collect, &sources) == 3);
+  assert(sources == (set<string>{"1", "2", "4"}));
+  sources.clear();
+  assert(maptel_sources_of(id, "2", collect, &sources) == 0);
+  assert(maptel_sources_of(id, "9", collect, &sources) == 0);
+
+  assert(maptel_chain_length(id, "1") == 2);
+  assert(maptel_chain_length(id, "3") == 0);
+  assert(maptel_chain_length(id, "5") == -1);
+
+  vector<set<string>> cycles;
+  assert(maptel_find_cycles(id, collect_cycle, &cycles) == 1);
+  assert(cycles[0] == (set<string>{"5", "6"}));
+
+  /* indeks nadąża za zmianami */
+  maptel_insert(id, "3", "1");
+  maptel_erase(id, "6");
+  cycles.clear();
+  assert(maptel_find_cycles(id, collect_cycle, &cycles) == 1);
+  assert(cycles[0] == (set<string>{"1", "2", "3"}));
+  assert(maptel_chain_length(id, "4") == -1);
+  assert(maptel_chain_length(id, "5") == 1);
+  sources.clear();
+  assert(maptel_sources_of(id, "6", collect, &sources) == 1);
+  assert(sources == set<string>{"5"});
+
+  maptel_erase(id, "3");
+  cycles.clear();
+  assert(maptel_find_cycles(id, collect_cycle, &cycles) == 0);
+  sources.clear();
+  assert(maptel_sources_of(id, "3", collect, &sources) == 3);
+  maptel_delete(id);
+
+  /* indeks zna tylko zmiany całych numerów, więc przy zmianach prefiksów
+   * i limicie zmian zapytania odmawiają odpowiedzi */
+  unsigned long mixed = maptel_create();
+  maptel_insert(mixed, "10", "20");
+  maptel_insert(mixed, "40", "50");
+  maptel_insert_prefix(mixed, "2", "3");
+  maptel_insert_prefix(mixed, "5", "4");
+  maptel_set_reverse_index(mixed, 1);
+  assert(transform(mixed, "10") == "30");
+  assert(transform(mixed, "40") == "40");  // cykl przez zmianę prefiksu
+  sources.clear();
+  assert(maptel_sources_of(mixed, "20", collect, &sources) == -1);
+  assert(maptel_find_cycles(mixed, collect_cycle, &cycles) == -1);
+  assert(sources.empty());
+  maptel_erase_prefix(mixed, "2");
+  maptel_erase_prefix(mixed, "5");
+  assert(maptel_sources_of(mixed, "20", collect, &sources) == 1);
+  assert(sources == set<string>{"10"});
+  cycles.clear();
+  assert(maptel_find_cycles(mixed, collect_cycle, &cycles) == 0);
+  maptel_set_hop_limit(mixed, 1);
+  assert(maptel_sources_of(mixed, "20", collect, &sources) == -1);
+  maptel_delete(mixed);
+}
+
+void trie_prefixes() {
+  unsigned long id = maptel_create_trie();
+  maptel_insert(id, "1234", "999");
+  maptel_insert(id, "12", "888");
+  maptel_insert_prefix(id, "12", "7");
+  maptel_insert_prefix(id, "123", "6");
+  maptel_insert_prefix(id, "5", "6");
+  assert(transform(id, "1234") == "999");  // numer przed prefiksem
+  assert(transform(id, "12") == "888");
+  assert(transform(id, "1235") == "65");   // najdłuższy prefiks
+  assert(transform(id, "129") == "79");
+  assert(transform(id, "13") == "13");
+  assert(transform(id, "5") == "6");       // cały numer jest prefiksem
+  assert(transform(id, "123") == "6");
+
+  /* zmiana, po której numer byłby za długi, nie jest stosowana */
+  maptel_insert_prefix(id, "4", "44444444444");
+  assert(transform(id, "412345678901") == "4444444444412345678901");
+  assert(transform(id, "4123456789012") == "4123456789012");
+
+  maptel_erase_prefix(id, "123");
+  assert(transform(id, "1235") == "735");
+  maptel_erase(id, "1234");
+  assert(transform(id, "1234") == "734");
+  maptel_erase_prefix(id, "9");
+  maptel_erase_prefix(id, "12");
+  assert(transform(id, "1235") == "1235");
+  assert(transform(id, "12") == "888");
+
+  /* zmiany prefiksów w słowniku z tablicą haszującą */
+  unsigned long hash = maptel_create();
+  maptel_insert(hash, "12", "3");
+  maptel_insert_prefix(hash, "1", "2");
+  assert(transform(hash, "12") == "3");
+  assert(transform(hash, "13") == "23");
+  maptel_delete(hash);
+  maptel_delete(id);
+}
+
+/* Zdarzenia wstawienia zgłoszone przez wątek zapisu w tle i liczba tych,
+ * których zmiana nie była jeszcze widoczna */
+size_t traced_inserts = 0, invisible_inserts = 0;
+
+void check_insert_visible(maptel_trace_event const *e) {
+  if (e->kind != MAPTEL_TRACE_INSERT)
+    return;
+  ++traced_inserts;
+  if (transform(e->id, e->tel_src) != e->tel_dst)
+    ++invisible_inserts;
+}
+
+void async_writes() {
+  unsigned long id = maptel_create();
+  maptel_set_async(id, 1);
+  for (int i = 0; i < 10000; ++i)
+    maptel_insert(id, to_string(100000 + i).c_str(),
+                  to_string(200000 + i).c_str());
+  for (int i = 0; i < 10000; i += 2)
+    maptel_erase(id, to_string(100000 + i).c_str());
+  maptel_flush(id);
+  for (int i = 0; i < 10000; ++i)
+    assert(transform(id, to_string(100000 + i).c_str()) ==
+           to_string(i % 2 ? 200000 + i : 100000 + i));
+
+  /* operacja zmieniająca cały słownik najpierw stosuje kolejkę */
+  maptel_insert(id, "1", "2");
+  unsigned long copy = maptel_clone(id);
+  assert(transform(copy, "1") == "2");
+
+  /* wyłączenie trybu stosuje wszystkie zlecone zmiany */
+  maptel_insert(id, "3", "4");
+  maptel_set_async(id, 0);
+  assert(transform(id, "3") == "4");
+  maptel_flush(id);
+
+  maptel_stats stats;
+  maptel_get_stats(id, &stats);
+  assert(stats.inserts == 10002);
+  assert(stats.erases == 5000);
+
+  /* zdarzenie wstawienia przychodzi dopiero po opublikowaniu zmiany */
+  maptel_set_async(id, 1);
+  maptel_set_trace(check_insert_visible);
+  for (int i = 0; i < 1000; ++i)
+    maptel_insert(id, to_string(700000 + i).c_str(),
+                  to_string(800000 + i).c_str());
+  maptel_flush(id);
+  maptel_set_trace(ignore_trace);
+  assert(traced_inserts == 1000);
+  assert(invisible_inserts == 0);
+  maptel_delete(copy);
+  maptel_delete(id);
+}
+
+/* Funkcja śledząca, która zmienia słownik w trakcie przekształcenia */
+void insert_on_transform(maptel_trace_event const *e) {
+  if (e->kind == MAPTEL_TRACE_TRANSFORM && strcmp(e->tel_src, "999") == 0)
+    maptel_insert(e->id, "998", "997");
+}
+
+void readers_during_writes() {
+  unsigned long id = maptel_create();
+  atomic<bool> done(false);
+  atomic<size_t> wrong(0);
+  vector<thread> readers;
+  for (int r = 0; r < 2; ++r)
+    readers.emplace_back([&, r]() {
+      for (int i = r; !done; ++i) {
+        string src = to_string(1000 + i % 100);
+        string dst = transform(id, src.c_str());
+        if (dst != src && dst != to_string(2000 + i % 100))
+          ++wrong;
+      }
+    });
+  for (int i = 0; i < 20000; ++i) {
+    string src = to_string(1000 + i % 100);
+    if (i % 3 == 0)
+      maptel_erase(id, src.c_str());
+    else
+      maptel_insert(id, src.c_str(), to_string(2000 + i % 100).c_str());
+  }
+  done = true;
+  for (auto &reader : readers)
+    reader.join();
+  assert(wrong == 0);
+
+  /* przekształcenie nie trzyma wersji, gdy wywołuje funkcję śledzącą */
+  maptel_set_trace(insert_on_transform);
+  assert(transform(id, "999") == "999");
+  maptel_set_trace(ignore_trace);
+  assert(transform(id, "998") == "997");
+  maptel_delete(id);
+}
+
+void compact() {
+  string path = temp_path("image");
+  unsigned long id = maptel_create();
+  for (int i = 0; i < 5000; ++i)
+    maptel_insert(id, to_string(100000 + i).c_str(),
+                  to_string(200000 + i).c_str());
+  assert(maptel_save(id, path.c_str()) == 0);
+  unsigned long loaded;
+  assert(maptel_load(path.c_str(), &loaded) == 0);
+
+  /* wpisy równe obrazowi są zbędne, usunięcia wpisów obrazu zostają */
+  for (int i = 0; i < 5000; ++i)
+    maptel_insert(loaded, to_string(100000 + i).c_str(),
+                  to_string(200000 + i).c_str());
+  maptel_erase(loaded, "100001");
+  maptel_insert(loaded, "100002", "7");
+  maptel_insert(loaded, "300000", "8");
+  maptel_insert_prefix(loaded, "9", "1");
+  maptel_set_reverse_index(loaded, 1);
+  size_t before = maptel_memory_usage(loaded);
+  unsigned long copy = maptel_clone(loaded);
+
+  maptel_compact(loaded);
+  assert(maptel_memory_usage(loaded) < before);
+  for (unsigned long d : {loaded, copy}) {
+    assert(transform(d, "100000") == "200000");
+    assert(transform(d, "100001") == "100001");
+    assert(transform(d, "100002") == "7");
+    assert(transform(d, "300000") == "8");
+    assert(transform(d, "95") == "15");
+  }
+  set<string> sources;
+  maptel_erase_prefix(loaded, "9");  // indeks nie zna zmian prefiksów
+  assert(maptel_sources_of(loaded, "8", collect, &sources) == 1);
+
+  maptel_insert(loaded, "100003", "6");
+  assert(transform(loaded, "100003") == "6");
+  assert(transform(copy, "100003") == "200003");
+  maptel_delete(loaded);
+  assert(transform(copy, "104999") == "204999");
+  maptel_delete(copy);
+  maptel_delete(id);
+  remove(path.c_str());
+}
+
+void clone_isolation() {
+  unsigned long id = maptel_create();
+  for (int i = 0; i < 2000; ++i)
+    maptel_insert(id, to_string(100000 + i).c_str(),
+                  to_string(200000 + i).c_str());
+  unsigned long copy = maptel_clone(id);
+  assert(transform(copy, "100005") == "200005");
+
+  maptel_insert(copy, "100005", "1");
+  maptel_erase(copy, "100006");
+  maptel_insert(id, "100007", "2");
+  maptel_erase(id, "100008");
+  assert(transform(id, "100005") == "200005");
+  assert(transform(id, "100006") == "200006");
+  assert(transform(id, "100007") == "2");
+  assert(transform(id, "100008") == "100008");
+  assert(transform(copy, "100005") == "1");
+  assert(transform(copy, "100006") == "100006");
+  assert(transform(copy, "100007") == "200007");
+  assert(transform(copy, "100008") == "200008");
+
+  /* kopia przeżywa oryginał */
+  unsigned long copy2 = maptel_clone(copy);
+  maptel_delete(id);
+  maptel_insert(copy2, "100009", "3");
+  assert(transform(copy, "100009") == "200009");
+  assert(transform(copy2, "100009") == "3");
+  assert(transform(copy2, "100005") == "1");
+  maptel_delete(copy);
+  assert(transform(copy2, "101999") == "201999");
+  maptel_delete(copy2);
+
+  unsigned long trie = maptel_create_trie();
+  maptel_insert(trie, "12", "34");
+  maptel_insert_prefix(trie, "5", "6");
+  unsigned long trie_copy = maptel_clone(trie);
+  maptel_insert(trie_copy, "12", "0");
+  maptel_erase_prefix(trie_copy, "5");
+  assert(transform(trie, "12") == "34");
+  assert(transform(trie, "55") == "65");
+  assert(transform(trie_copy, "12") == "0");
+  assert(transform(trie_copy, "55") == "55");
+  maptel_delete(trie_copy);
+  maptel_delete(trie);
+}
+
+void hop_limit() {
+  unsigned long id = maptel_create();
+  for (int i = 0; i < 10; ++i)
+    maptel_insert(id, to_string(i).c_str(), to_string(i + 1).c_str());
+  char tel[TEL_NUM_MAX_LEN + 1];
+  assert(maptel_transform_bounded(id, "0", tel, sizeof(tel)) == 0);
+  assert(string(tel) == "10");
+
+  maptel_set_hop_limit(id, 3);
+  assert(maptel_transform_bounded(id, "0", tel, sizeof(tel)) == 1);
+  assert(string(tel) == "3");
+  assert(maptel_transform_bounded(id, "7", tel, sizeof(tel)) == 0);
+  assert(string(tel) == "10");
+  assert(transform(id, "5") == "8");
+
+  maptel_insert(id, "10", "0");      // cykl dłuższy niż limit
+  assert(maptel_transform_bounded(id, "0", tel, sizeof(tel)) == 1);
+  assert(string(tel) == "3");
+  maptel_set_hop_limit(id, 0);
+  assert(maptel_transform_bounded(id, "0", tel, sizeof(tel)) == 0);
+  assert(string(tel) == "0");
+
+  maptel_stats stats;
+  maptel_get_stats(id, &stats);
+  assert(stats.truncated == 3);
+  maptel_delete(id);
+}
+
+void overlays() {
+  unsigned long first = maptel_create(), second = maptel_create_trie();
+  maptel_insert(first, "1", "2");
+  maptel_insert(second, "2", "3");
+  unsigned long ids[] = {first, second};
+  unsigned long overlay = maptel_overlay_create(ids, 2);
+
+  char tel[TEL_NUM_MAX_LEN + 1];
+  assert(maptel_overlay_transform(overlay, "1", tel, sizeof(tel)) == 0);
+  assert(string(tel) == "3");
+  maptel_overlay_transform(overlay, "1", tel, sizeof(tel));
+  assert(string(tel) == "3");        // wynik z pamięci warstw
+
+  /* zmiana słownika unieważnia pamiętane wyniki jego warstwy */
+  maptel_insert(second, "2", "4");
+  maptel_overlay_transform(overlay, "1", tel, sizeof(tel));
+  assert(string(tel) == "4");
+  maptel_insert(first, "1", "5");
+  maptel_overlay_transform(overlay, "1", tel, sizeof(tel));
+  assert(string(tel) == "5");
+  maptel_erase(first, "1");
+  maptel_overlay_transform(overlay, "1", tel, sizeof(tel));
+  assert(string(tel) == "1");
+  maptel_insert_prefix(first, "1", "2");
+  maptel_overlay_transform(overlay, "1", tel, sizeof(tel));
+  assert(string(tel) == "4");
+
+  maptel_set_hop_limit(second, 1);
+  maptel_insert(second, "4", "6");
+  assert(maptel_overlay_transform(overlay, "1", tel, sizeof(tel)) == 1);
+  assert(string(tel) == "4");
+
+  /* zmiana limitu unieważnia pamiętane wyniki, choć wersja ta sama */
+  maptel_set_hop_limit(second, 0);
+  assert(maptel_overlay_transform(overlay, "1", tel, sizeof(tel)) == 0);
+  assert(string(tel) == "6");
+  assert(maptel_overlay_transform(overlay, "1", tel, sizeof(tel)) == 0);
+  maptel_set_hop_limit(second, 1);
+  assert(maptel_overlay_transform(overlay, "1", tel, sizeof(tel)) == 1);
+  assert(string(tel) == "4");
+  assert(maptel_overlay_transform(overlay, "1", tel, sizeof(tel)) == 1);
+  assert(string(tel) == "4");        // przerwany wynik z pamięci warstw
+
+  maptel_overlay_delete(overlay);
+  maptel_delete(second);
+  maptel_delete(first);
+}
+
+int main() {
+  maptel_set_trace(ignore_trace);
+  basic_operations();
+  save_and_load();
+  corrupt_images();
+  load_file();
+  reverse_index();
+  trie_prefixes();
+  async_writes();
+  readers_during_writes();
+  compact();
+  clone_isolation();
+  hop_limit();
+  overlays();
+  return 0;
+}
@@ -0,0 +1,112 @@
+/* Numer telefonu przechowywany w węzłach słownika */
+#ifndef number_h
+#define number_h
+
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <string>
+#include "maptel.h"
+
+/* Numer lub jego fragment, najwyżej TEL_NUM_MAX_LEN cyfr zapisanych
+ * w samym obiekcie i zakończonych '\0'. Węzeł z numerem nie przydziela
+ * dla niego osobnej pamięci, więc cały leży w puli słownika */
+class Number {
+public:
+  Number() : len(0) {
+    digits[0] = '\0';
+  }
+
+  Number(char const *s, size_t n) : len(static_cast<unsigned char>(n)) {
+    assert(n <= TEL_NUM_MAX_LEN);
+    memcpy(digits, s, n);
+    digits[n] = '\0';
+  }
+
+  Number(char const *s) : Number(s, strlen(s)) {}
+  Number(std::string const &s) : Number(s.data(), s.size()) {}
+
+  size_t size() const { return len; }
+  bool empty() const { return len == 0; }
+  char const* c_str() const { return digits; }
+  char operator[](size_t i) const { return digits[i]; }
+
+  std::string str() const {
+    return std::string(digits, len);
+  }
+
+  /* Fragment długości n od pozycji pos */
+  Number substr(size_t pos, size_t n) const {
+    return Number(digits + pos, n);
+  }
+
+  /* Zwraca true, jeśli od pozycji pos numer zawiera cały part */
+  bool has_at(size_t pos, Number const &part) const {
+    return part.len <= len - pos &&
+           memcmp(digits + pos, part.digits, part.len) == 0;
+  }
+
+  void append(Number const &tail) {
+    assert(len + tail.len <= TEL_NUM_MAX_LEN);
+    memcpy(digits + len, tail.digits, tail.len + 1);
+    len += tail.len;
+  }
+
+  /* Skraca numer do n pierwszych cyfr */
+  void truncate(size_t n) {
+    len = static_cast<unsigned char>(n);
+    digits[n] = '\0';
+  }
+
+  /* Usuwa n pierwszych cyfr */
+  void erase_front(size_t n) {
+    memmove(digits, digits + n, len - n + 1);
+    len -= n;
+  }
+
+  /* Dopisuje head na początku */
+  void prepend(Number const &head) {
+    assert(len + head.len <= TEL_NUM_MAX_LEN);
+    memmove(digits + head.len, digits, len + 1);
+    memcpy(digits, head.digits, head.len);
+    len += head.len;
+  }
+
+  /* Funkcja haszująca FNV-1a. Młodsze bity iloczynu zależą tylko od
+   * młodszych bitów cyfr, a PersistentMap wybiera dzieci właśnie nimi,
+   * więc na końcu bity są mieszane jak w MurmurHash3 */
+  size_t hash() const {
+    uint64_t h = 14695981039346656037ULL;
+    for (size_t i = 0; i < len; ++i) {
+      h ^= static_cast<unsigned char>(digits[i]);
+      h *= 1099511628211ULL;
+    }
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    return h;
+  }
+
+  friend bool operator==(Number const &a, Number const &b) {
+    return a.len == b.len && memcmp(a.digits, b.digits, a.len) == 0;
+  }
+
+  friend bool operator!=(Number const &a, Number const &b) {
+    return !(a == b);
+  }
+
+private:
+  unsigned char len;
+  char digits[TEL_NUM_MAX_LEN + 1];
+};
+
+namespace std {
+  template <>
+  struct hash<Number> {
+    size_t operator()(Number const &n) const { return n.hash(); }
+  };
+}
+
+#endif
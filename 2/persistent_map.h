@@ -0,0 +1,307 @@
+/* Trwała mapa haszująca (hash array mapped trie) współdzieląca węzły
+ * między kopiami */
+#ifndef persistent_map_h
+#define persistent_map_h
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <utility>
+#include <vector>
+#include "arena.h"
+#include "edit_token.h"
+
+/* Kopiowanie mapy kosztuje O(1) - kopia współdzieli wszystkie węzły.
+ * Zmiana mapy kopiuje węzły na ścieżce od korzenia, które nie mają jej
+ * znacznika edycji (edit_token.h), a węzły utworzone przez nią od
+ * ostatniego skopiowania zmienia w miejscu. Dzięki temu każda kopia jest
+ * niezmiennym obrazem stanu z chwili jej utworzenia, a seria zmian jednej
+ * mapy nie kopiuje węzłów utworzonych w tej serii.
+ * Odczyty nie zmieniają liczników referencji, więc wiele wątków może
+ * czytać kopię, którą inny wątek trzyma tylko do odczytu.
+ * Węzły wraz z tablicami dzieci i wpisów są przydzielane z puli
+ * przekazanej w konstruktorze, wspólnej dla wszystkich kopii; bez puli
+ * z operator new. */
+template <typename Key, typename Value, typename Hash = std::hash<Key>>
+class PersistentMap {
+public:
+  explicit PersistentMap(std::shared_ptr<Arena> arena = nullptr)
+    : pool(std::move(arena)), root(), count(0), edit(new_edit_token()) {}
+
+  /* Odbiera oryginałowi prawo zmieniania w miejscu wspólnych węzłów */
+  PersistentMap(PersistentMap const &other)
+    : pool(other.pool), root(other.root), count(other.count),
+      edit(new_edit_token()) {
+    other.edit.store(new_edit_token(), std::memory_order_relaxed);
+  }
+
+  /* Kopia, która nowe węzły przydziela z puli arena. Pula węzłów
+   * oryginału musi istnieć tak długo jak ta kopia */
+  PersistentMap(PersistentMap const &other, std::shared_ptr<Arena> arena)
+    : pool(std::move(arena)), root(other.root), count(other.count),
+      edit(new_edit_token()) {
+    other.edit.store(new_edit_token(), std::memory_order_relaxed);
+  }
+
+  PersistentMap(PersistentMap &&other)
+    : pool(std::move(other.pool)), root(std::move(other.root)),
+      count(other.count), edit(other.edit.load(std::memory_order_relaxed)) {
+    other.count = 0;
+    other.edit.store(new_edit_token(), std::memory_order_relaxed);
+  }
+
+  /* Węzły poprzedniej zawartości wracają do jej puli, zanim pula zostanie
+   * puszczona */
+  PersistentMap& operator=(PersistentMap other) {
+    std::swap(pool, other.pool);
+    std::swap(root, other.root);
+    std::swap(count, other.count);
+    uint64_t token = edit.load(std::memory_order_relaxed);
+    edit.store(other.edit.load(std::memory_order_relaxed),
+               std::memory_order_relaxed);
+    other.edit.store(token, std::memory_order_relaxed);
+    return *this;
+  }
+
+  std::shared_ptr<Arena> const& arena() const { return pool; }
+
+  size_t size() const { return count; }
+  bool empty() const { return count == 0; }
+
+  /* Zwraca wskaźnik na wartość pod kluczem key lub nullptr */
+  Value const* find(Key const &key) const {
+    size_t hash = Hash()(key);
+    Node const *node = root.get();
+    for (unsigned shift = 0; node != nullptr; shift += BITS) {
+      if (node->is_leaf()) {
+        if (node->hash != hash)
+          return nullptr;
+        for (auto const &e : node->entries)
+          if (e.first == key)
+            return &e.second;
+        return nullptr;
+      }
+      uint32_t bit = bit_of(hash, shift);
+      if ((node->bitmap & bit) == 0)
+        return nullptr;
+      node = node->children[position(node->bitmap, bit)].get();
+    }
+    return nullptr;
+  }
+
+  /* Wstawia lub nadpisuje wartość pod kluczem key */
+  void set(Key const &key, Value const &value) {
+    bool added = false;
+    root = set(root, Hash()(key), 0, key, value, added);
+    if (added)
+      ++count;
+  }
+
+  /* Usuwa klucz key, zwraca false, jeśli go nie było */
+  bool erase(Key const &key) {
+    if (find(key) == nullptr)
+      return false;
+    root = erase(root, Hash()(key), 0, key);
+    --count;
+    return true;
+  }
+
+  /* Wywołuje f(klucz, wartość) dla każdego wpisu */
+  template <typename F>
+  void for_each(F f) const {
+    for_each(root.get(), f);
+  }
+
+  /* Przebudowuje węzły tak, aby ich tablice zajmowały tylko tyle pamięci,
+   * ile potrzebują. Mapa przestaje współdzielić węzły z innymi kopiami */
+  void compact() {
+    root = compact(root.get());
+  }
+
+private:
+  /* Liczba bitów haszu wybierających dziecko na jednym poziomie */
+  static const unsigned BITS = 5;
+
+  struct Node;
+  using NodePtr = std::shared_ptr<Node>;
+  using Entry = std::pair<Key, Value>;
+
+  /* Węzeł wewnętrzny ma niepustą mapę bitową i tyle dzieci, ile bitów
+   * jest w niej ustawionych. Liść ma pustą mapę bitową i przechowuje
+   * wszystkie wpisy o tym samym haszu */
+  struct Node {
+    uint32_t bitmap = 0;
+    size_t hash = 0;
+    uint64_t edit = 0;               // znacznik mapy, która utworzyła węzeł
+    std::vector<NodePtr, ArenaAllocator<NodePtr>> children;
+    std::vector<Entry, ArenaAllocator<Entry>> entries;
+
+    explicit Node(Arena *arena)
+      : children(ArenaAllocator<NodePtr>(arena)),
+        entries(ArenaAllocator<Entry>(arena)) {}
+
+    /* Kopia, której tablice są przydzielone z puli arena, a nie z puli
+     * oryginału, bo z tej może przydzielać inny piszący */
+    Node(Node const &other, Arena *arena)
+      : bitmap(other.bitmap), hash(other.hash), edit(other.edit),
+        children(other.children, ArenaAllocator<NodePtr>(arena)),
+        entries(other.entries, ArenaAllocator<Entry>(arena)) {}
+
+    bool is_leaf() const { return bitmap == 0; }
+  };
+
+  std::shared_ptr<Arena> pool;       // niszczona po root
+  NodePtr root;
+  size_t count;
+  /* Zmieniany także przez kopiowanie, które nie zmienia zawartości mapy,
+   * więc może odbywać się równolegle z odczytami i innym kopiowaniem */
+  mutable std::atomic<uint64_t> edit;
+
+  /* Tworzy węzeł ze znacznikiem tej mapy */
+  template <typename... Args>
+  NodePtr make_node(Args &&... args) const {
+    NodePtr node = std::allocate_shared<Node>(
+      ArenaAllocator<Node>(pool.get()), std::forward<Args>(args)...,
+      pool.get());
+    node->edit = edit.load(std::memory_order_relaxed);
+    return node;
+  }
+
+  static uint32_t bit_of(size_t hash, unsigned shift) {
+    return static_cast<uint32_t>(1) << ((hash >> shift) & ((1 << BITS) - 1));
+  }
+
+  static size_t position(uint32_t bitmap, uint32_t bit) {
+    return __builtin_popcount(bitmap & (bit - 1));
+  }
+
+  /* Zwraca węzeł, który wolno zmieniać w miejscu: sam node, jeśli ma
+   * znacznik tej mapy, a w przeciwnym razie jego kopię */
+  NodePtr own(NodePtr const &node) const {
+    if (node->edit == edit.load(std::memory_order_relaxed))
+      return node;
+    return make_node(*node);
+  }
+
+  NodePtr make_leaf(size_t hash, Key const &key, Value const &value) const {
+    NodePtr leaf = make_node();
+    leaf->hash = hash;
+    leaf->entries.emplace_back(key, value);
+    return leaf;
+  }
+
+  NodePtr set(NodePtr const &node, size_t hash, unsigned shift,
+              Key const &key, Value const &value, bool &added) const {
+    if (!node) {
+      added = true;
+      return make_leaf(hash, key, value);
+    }
+
+    if (node->is_leaf()) {
+      if (node->hash == hash) {
+        NodePtr result = own(node);
+        for (auto &e : result->entries) {
+          if (e.first == key) {
+            e.second = value;
+            return result;
+          }
+        }
+        added = true;
+        result->entries.emplace_back(key, value);
+        return result;
+      }
+      /* różne hasze - liść staje się dzieckiem nowego węzła
+       * wewnętrznego */
+      NodePtr branch = make_node();
+      branch->bitmap = bit_of(node->hash, shift);
+      branch->children.push_back(node);
+      return set(branch, hash, shift, key, value, added);
+    }
+
+    NodePtr result = own(node);
+    uint32_t bit = bit_of(hash, shift);
+    size_t pos = position(result->bitmap, bit);
+    if (result->bitmap & bit) {
+      NodePtr &child = result->children[pos];
+      NodePtr changed = set(child, hash, shift + BITS, key, value, added);
+      child = std::move(changed);
+    } else {
+      result->bitmap |= bit;
+      result->children.insert(result->children.begin() + pos,
+                              make_leaf(hash, key, value));
+      added = true;
+    }
+    return result;
+  }
+
+  /* Usuwa klucz, który na pewno jest w poddrzewie node */
+  NodePtr erase(NodePtr const &node, size_t hash, unsigned shift,
+                Key const &key) const {
+    if (node->is_leaf()) {
+      if (node->entries.size() == 1)
+        return nullptr;
+      NodePtr result = own(node);
+      for (size_t i = 0; i < result->entries.size(); ++i) {
+        if (result->entries[i].first == key) {
+          result->entries.erase(result->entries.begin() + i);
+          break;
+        }
+      }
+      return result;
+    }
+
+    uint32_t bit = bit_of(hash, shift);
+    size_t pos = position(node->bitmap, bit);
+    NodePtr const &old_child = node->children[pos];
+    if (old_child->is_leaf() && old_child->entries.size() == 1) {
+      if (node->children.size() == 1)
+        return nullptr;
+      /* jedyny pozostały liść zastępuje węzeł wewnętrzny */
+      if (node->children.size() == 2 && node->children[1 - pos]->is_leaf())
+        return node->children[1 - pos];
+    }
+
+    /* dzieci kopii zachowują swoje znaczniki, więc dziecko utworzone
+     * przed skopiowaniem mapy zostanie skopiowane, zanim zostanie
+     * zmienione */
+    NodePtr result = own(node);
+    NodePtr child = erase(result->children[pos], hash, shift + BITS, key);
+    if (!child) {
+      result->bitmap &= ~bit;
+      result->children.erase(result->children.begin() + pos);
+    } else if (result->children.size() == 1 && child->is_leaf()) {
+      return child;
+    } else {
+      result->children[pos] = std::move(child);
+    }
+    return result;
+  }
+
+  NodePtr compact(Node const *node) const {
+    if (node == nullptr)
+      return nullptr;
+    NodePtr result = make_node();
+    result->bitmap = node->bitmap;
+    result->hash = node->hash;
+    result->entries.reserve(node->entries.size());
+    for (auto const &e : node->entries)
+      result->entries.emplace_back(e.first, e.second);
+    result->children.reserve(node->children.size());
+    for (auto const &child : node->children)
+      result->children.push_back(compact(child.get()));
+    return result;
+  }
+
+  template <typename F>
+  static void for_each(Node const *node, F &f) {
+    if (node == nullptr)
+      return;
+    for (auto const &e : node->entries)
+      f(e.first, e.second);
+    for (auto const &child : node->children)
+      for_each(child.get(), f);
+  }
+};
+
+#endif
@@ -0,0 +1,740 @@
+#ifndef JNP1_LIMBS_H
+#define JNP1_LIMBS_H
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/* Operacje na ciągach cyfr (limbów) liczby w systemie little endian,
+ * podanych wskaźnikiem i długością. Funkcje działają na buforach
+ * przekazanych przez wywołującego i, poza multiply i mulNtt bez podanego
+ * bufora, nie przydzielają pamięci. Wynik może być zapisany w miejscu
+ * pierwszego argumentu, o ile opis funkcji nie mówi inaczej. */
+
+/* Szerokość cyfry w bitach: 64 (iloczyny w unsigned __int128) albo 32 */
+#ifndef VERY_LONG_INT_LIMB_BITS
+#define VERY_LONG_INT_LIMB_BITS 64
+#endif
+
+namespace limbs {
+
+/* Cyfra, typ mieszczący iloczyn dwóch cyfr oraz długości czynników, od
+ * których opłaca się mnożenie Karatsuby, Toom-3 i transformata (NTT).
+ * Transformata liczy na słowach 32-bitowych, więc przy cyfrach
+ * 64-bitowych opłaca się później */
+#if VERY_LONG_INT_LIMB_BITS == 64
+using Limb = uint64_t;
+using DoubleLimb = unsigned __int128;
+const size_t KARATSUBA_THRESHOLD = 20;
+const size_t TOOM3_THRESHOLD = 120;
+const size_t NTT_THRESHOLD = 4000;
+#elif VERY_LONG_INT_LIMB_BITS == 32
+using Limb = uint32_t;
+using DoubleLimb = uint64_t;
+const size_t KARATSUBA_THRESHOLD = 40;
+const size_t TOOM3_THRESHOLD = 160;
+const size_t NTT_THRESHOLD = 1500;
+#else
+#error "VERY_LONG_INT_LIMB_BITS musi wynosić 32 albo 64"
+#endif
+const unsigned LIMB_BITS = VERY_LONG_INT_LIMB_BITS;
+
+/* Największa długość iloczynu liczonego transformatą, 2^25 słów
+ * 32-bitowych */
+const size_t NTT_MAX_LENGTH = (static_cast<size_t>(1) << 25) * 32 / LIMB_BITS;
+
+inline void clear(Limb *r, size_t n) {
+    std::fill(r, r + n, static_cast<Limb>(0));
+}
+
+/* Porównuje a i b długości n, zwraca -1, 0 lub 1 */
+inline int compare(const Limb *a, const Limb *b, size_t n) {
+    while (n > 0) {
+        --n;
+        if (a[n] != b[n])
+            return a[n] < b[n] ? -1 : 1;
+    }
+    return 0;
+}
+
+/* r = a + b, a i b długości n. Zwraca przeniesienie */
+inline Limb addN(Limb *r, const Limb *a, const Limb *b, size_t n) {
+    Limb carry = 0;
+    for (size_t i = 0; i < n; ++i) {
+        DoubleLimb sum = static_cast<DoubleLimb>(a[i]) + b[i] + carry;
+        r[i] = static_cast<Limb>(sum);
+        carry = static_cast<Limb>(sum >> LIMB_BITS);
+    }
+    return carry;
+}
+
+/* r = a + c, a długości n. Zwraca przeniesienie */
+inline Limb add1(Limb *r, const Limb *a, size_t n, Limb c) {
+    size_t i = 0;
+    for (; i < n && c != 0; ++i) {
+        Limb sum = a[i] + c;
+        c = sum < c;
+        r[i] = sum;
+    }
+    if (r != a)
+        std::copy(a + i, a + n, r + i);
+    return c;
+}
+
+/* r = a + b, an >= bn. Zwraca przeniesienie */
+inline Limb add(Limb *r, const Limb *a, size_t an,
+                const Limb *b, size_t bn) {
+    assert(an >= bn);
+    Limb carry = addN(r, a, b, bn);
+    return add1(r + bn, a + bn, an - bn, carry);
+}
+
+/* r = a - b, a i b długości n. Zwraca pożyczkę */
+inline Limb subN(Limb *r, const Limb *a, const Limb *b, size_t n) {
+    Limb borrow = 0;
+    for (size_t i = 0; i < n; ++i) {
+        Limb x = a[i], y = b[i];
+        Limb diff = x - y - borrow;
+        borrow = (x < y) || (x == y && borrow);
+        r[i] = diff;
+    }
+    return borrow;
+}
+
+/* r = a - c, a długości n. Zwraca pożyczkę */
+inline Limb sub1(Limb *r, const Limb *a, size_t n, Limb c) {
+    size_t i = 0;
+    for (; i < n && c != 0; ++i) {
+        Limb x = a[i];
+        r[i] = x - c;
+        c = x < c;
+    }
+    if (r != a)
+        std::copy(a + i, a + n, r + i);
+    return c;
+}
+
+/* r = a - b, an >= bn. Zwraca pożyczkę */
+inline Limb sub(Limb *r, const Limb *a, size_t an,
+                const Limb *b, size_t bn) {
+    assert(an >= bn);
+    Limb borrow = subN(r, a, b, bn);
+    return sub1(r + bn, a + bn, an - bn, borrow);
+}
+
+/* r = a * b, a długości n. Zwraca najstarszą cyfrę iloczynu */
+inline Limb mul1(Limb *r, const Limb *a, size_t n, Limb b) {
+    Limb carry = 0;
+    for (size_t i = 0; i < n; ++i) {
+        DoubleLimb tmp = static_cast<DoubleLimb>(a[i]) * b + carry;
+        r[i] = static_cast<Limb>(tmp);
+        carry = static_cast<Limb>(tmp >> LIMB_BITS);
+    }
+    return carry;
+}
+
+/* r += a * b, a i r długości n. Zwraca przeniesienie */
+inline Limb addMul1(Limb *r, const Limb *a, size_t n, Limb b) {
+    Limb carry = 0;
+    for (size_t i = 0; i < n; ++i) {
+        DoubleLimb tmp = static_cast<DoubleLimb>(a[i]) * b + r[i] + carry;
+        r[i] = static_cast<Limb>(tmp);
+        carry = static_cast<Limb>(tmp >> LIMB_BITS);
+    }
+    return carry;
+}
+
+/* r -= a * b, a i r długości n. Zwraca pożyczkę */
+inline Limb subMul1(Limb *r, const Limb *a, size_t n, Limb b) {
+    Limb borrow = 0;
+    for (size_t i = 0; i < n; ++i) {
+        DoubleLimb tmp = static_cast<DoubleLimb>(a[i]) * b + borrow;
+        Limb low = static_cast<Limb>(tmp), x = r[i];
+        r[i] = x - low;
+        borrow = static_cast<Limb>(tmp >> LIMB_BITS) + (x < low);
+    }
+    return borrow;
+}
+
+/* r = a << bits, a długości n, bits < LIMB_BITS. Zwraca wysunięte bity */
+inline Limb shiftLeft(Limb *r, const Limb *a, size_t n, unsigned bits) {
+    if (bits == 0) {
+        std::copy(a, a + n, r);
+        return 0;
+    }
+    Limb out = 0;
+    for (size_t i = 0; i < n; ++i) {
+        Limb x = a[i];
+        r[i] = (x << bits) | out;
+        out = x >> (LIMB_BITS - bits);
+    }
+    return out;
+}
+
+/* r = a >> bits, a długości n, bits < LIMB_BITS */
+inline void shiftRight(Limb *r, const Limb *a, size_t n, unsigned bits) {
+    if (bits == 0) {
+        std::copy(a, a + n, r);
+        return;
+    }
+    for (size_t i = 0; i + 1 < n; ++i)
+        r[i] = (a[i] >> bits) | (a[i + 1] << (LIMB_BITS - bits));
+    if (n > 0)
+        r[n - 1] = a[n - 1] >> bits;
+}
+
+/* Liczba zer przed najstarszą jedynką x, x != 0 */
+inline unsigned leadingZeros(Limb x) {
+    assert(x != 0);
+    unsigned bits = 0;
+    for (Limb top = static_cast<Limb>(1) << (LIMB_BITS - 1); !(x & top);
+         x <<= 1)
+        ++bits;
+    return bits;
+}
+
+/* a >>= 1, a długości n */
+inline void shiftRight1(Limb *a, size_t n) {
+    for (size_t i = 0; i + 1 < n; ++i)
+        a[i] = (a[i] >> 1) | (a[i + 1] << (LIMB_BITS - 1));
+    if (n > 0)
+        a[n - 1] >>= 1;
+}
+
+/* a /= 3, gdy a jest podzielne przez 3. Mnoży przez odwrotność 3 modulo
+ * baza, od najmłodszej cyfry, zamiast dzielić */
+inline void divExactBy3(Limb *a, size_t n) {
+    const Limb inverse = static_cast<Limb>(~static_cast<Limb>(0) / 3 * 2 + 1);
+    Limb borrow = 0;
+    for (size_t i = 0; i < n; ++i) {
+        Limb x = a[i];
+        Limb under = x < borrow;
+        Limb q = static_cast<Limb>((x - borrow) * inverse);
+        a[i] = q;
+        borrow = static_cast<Limb>((static_cast<DoubleLimb>(q) * 3) >>
+                                   LIMB_BITS) + under;
+    }
+    assert(borrow == 0);
+}
+
+/* Operacja bitowa op (na dwóch cyfrach) w kodzie uzupełnień do dwóch na
+ * liczbach w postaci znak-moduł: a i b to moduły, a_negative i b_negative
+ * znaki. Kod uzupełnień ujemnej liczby, ~(|x| - 1), i moduł wyniku
+ * powstają cyfra po cyfrze razem z op. r ma długość n > max(an, bn)
+ * i nie może nachodzić na a ani b. Zwraca znak wyniku */
+template <typename Op>
+inline bool bitwise(Limb *r, size_t n, const Limb *a, size_t an,
+                    bool a_negative, const Limb *b, size_t bn,
+                    bool b_negative, Op op) {
+    assert(n > std::max(an, bn));
+    const Limb ones = ~static_cast<Limb>(0);
+    Limb a_mask = a_negative ? ones : 0, b_mask = b_negative ? ones : 0;
+    Limb r_mask = op(a_mask, b_mask);
+    Limb a_borrow = a_negative, b_borrow = b_negative, r_carry = r_mask & 1;
+    for (size_t i = 0; i < n; ++i) {
+        Limb x = i < an ? a[i] : 0, y = i < bn ? b[i] : 0;
+        Limb tx = (x - a_borrow) ^ a_mask, ty = (y - b_borrow) ^ b_mask;
+        a_borrow &= x == 0;
+        b_borrow &= y == 0;
+        Limb z = (op(tx, ty) ^ r_mask) + r_carry;
+        r_carry &= z == 0;
+        r[i] = z;
+    }
+    return r_mask != 0;
+}
+
+/* r = a * b szkolnie, r długości an + bn, nie może nachodzić na a ani b */
+inline void mulBasecase(Limb *r, const Limb *a, size_t an,
+                        const Limb *b, size_t bn) {
+    r[an] = mul1(r, a, an, b[0]);
+    for (size_t j = 1; j < bn; ++j)
+        r[an + j] = addMul1(r + j, a, an, b[j]);
+}
+
+/* q = a / d, a i q długości n. Zwraca resztę */
+inline Limb divRem1(Limb *q, const Limb *a, size_t n, Limb d) {
+    assert(d != 0);
+    DoubleLimb rest = 0;
+    for (size_t i = n; i > 0; --i) {
+        DoubleLimb cur = (rest << LIMB_BITS) | a[i - 1];
+        q[i - 1] = static_cast<Limb>(cur / d);
+        rest = cur % d;
+    }
+    return static_cast<Limb>(rest);
+}
+
+/* Algorytm D Knutha. u długości un + 1, v długości vn >= 2 ma zapaloną
+ * najstarszą cyfrę (jest znormalizowane), un >= vn. Zapisuje iloraz
+ * w q długości un - vn + 1, a resztę w u[0..vn). Cyfrę ilorazu
+ * przybliża iloraz dwóch najstarszych cyfr u przez najstarszą cyfrę v,
+ * poprawiany najwyżej dwa razy o drugą cyfrę v, a po odjęciu - jeszcze
+ * raz, jeśli reszta wyszła ujemna */
+inline void divRemNormalized(Limb *q, Limb *u, size_t un,
+                             const Limb *v, size_t vn) {
+    assert(vn >= 2 && un >= vn && (v[vn - 1] >> (LIMB_BITS - 1)) == 1);
+    const DoubleLimb base = static_cast<DoubleLimb>(1) << LIMB_BITS;
+    const Limb top = v[vn - 1], second = v[vn - 2];
+    for (size_t j = un - vn + 1; j > 0; --j) {
+        Limb *w = u + j - 1;
+        DoubleLimb num = (static_cast<DoubleLimb>(w[vn]) << LIMB_BITS) |
+                         w[vn - 1];
+        DoubleLimb qhat = num / top, rhat = num % top;
+        while (qhat >= base ||
+               qhat * second > ((rhat << LIMB_BITS) | w[vn - 2])) {
+            --qhat;
+            rhat += top;
+            if (rhat >= base)
+                break;
+        }
+        Limb digit = static_cast<Limb>(qhat);
+        Limb borrow = subMul1(w, v, vn, digit);
+        if (w[vn] < borrow) {
+            --digit;
+            w[vn] += addN(w, w, v, vn);
+        }
+        w[vn] -= borrow;
+        q[j - 1] = digit;
+    }
+}
+
+/* Rozmiar bufora pomocniczego potrzebnego divRem */
+inline size_t divScratch(size_t an, size_t bn) {
+    return an + 1 + bn;
+}
+
+/* q = a / b, r = a % b, an >= bn, najstarsza cyfra b niezerowa. q ma
+ * długość an - bn + 1, r długość bn, scratch co najmniej
+ * divScratch(an, bn) cyfr. Dzielna i dzielnik są przesuwane tak, aby
+ * najstarszy bit dzielnika był zapalony */
+inline void divRem(Limb *q, Limb *r, const Limb *a, size_t an,
+                   const Limb *b, size_t bn, Limb *scratch) {
+    assert(an >= bn && bn > 0 && b[bn - 1] != 0);
+    if (bn == 1) {
+        r[0] = divRem1(q, a, an, b[0]);
+        return;
+    }
+    unsigned bits = leadingZeros(b[bn - 1]);
+    Limb *u = scratch, *v = u + an + 1;
+    u[an] = shiftLeft(u, a, an, bits);
+    shiftLeft(v, b, bn, bits);
+    divRemNormalized(q, u, an, v, bn);
+    shiftRight(r, u, bn, bits);
+}
+
+/* Czy czynniki długości n mnoży transformata */
+inline bool useNtt(size_t n) {
+    return n >= NTT_THRESHOLD && 2 * n <= NTT_MAX_LENGTH;
+}
+
+/* r += a * b szkolnie, wiersz po wierszu, bez bufora na iloczyn. r ma
+ * długość rn >= an + bn i nie może nachodzić na a ani b. Zwraca
+ * przeniesienie */
+inline Limb addMulBasecase(Limb *r, size_t rn, const Limb *a, size_t an,
+                           const Limb *b, size_t bn) {
+    assert(rn >= an + bn);
+    Limb carry = 0;
+    for (size_t j = 0; j < bn; ++j) {
+        Limb top = addMul1(r + j, a, an, b[j]);
+        carry += add1(r + j + an, r + j + an, rn - j - an, top);
+    }
+    return carry;
+}
+
+/* r -= a * b szkolnie, jak addMulBasecase. Zwraca pożyczkę */
+inline Limb subMulBasecase(Limb *r, size_t rn, const Limb *a, size_t an,
+                           const Limb *b, size_t bn) {
+    assert(rn >= an + bn);
+    Limb borrow = 0;
+    for (size_t j = 0; j < bn; ++j) {
+        Limb top = subMul1(r + j, a, an, b[j]);
+        borrow += sub1(r + j + an, r + j + an, rn - j - an, top);
+    }
+    return borrow;
+}
+
+/* Rozmiar bufora pomocniczego potrzebnego mulN dla czynników długości n */
+inline size_t mulScratch(size_t n) {
+    if (n < KARATSUBA_THRESHOLD || useNtt(n))
+        return 0;
+    /* mulScratch nie jest monotoniczna, bo krótsza część może trafić do
+     * Karatsuby, a dłuższa do Toom-3 */
+    if (n < TOOM3_THRESHOLD) {
+        size_t h = n / 2, k = n - h;
+        return 6 * k + 1 + std::max(mulScratch(k), mulScratch(h));
+    }
+    size_t k = (n + 2) / 3, s = n - 2 * k, m = k + 1;
+    return 12 * m + std::max(mulScratch(m),
+                             std::max(mulScratch(k), mulScratch(s)));
+}
+
+inline void mulN(Limb *r, const Limb *a, const Limb *b, size_t n,
+                 Limb *scratch);
+
+/* d = |x0 - x1|, x0 długości h, x1 długości k, k >= h >= k - 1.
+ * d ma długość k. Zwraca true, jeśli x0 < x1 */
+inline bool absDiff(Limb *d, const Limb *x0, size_t h,
+                    const Limb *x1, size_t k) {
+    bool less = (k > h && x1[h] != 0) || compare(x0, x1, h) < 0;
+    if (less) {
+        sub(d, x1, k, x0, h);
+    } else {
+        subN(d, x0, x1, h);
+        if (k > h)
+            d[h] = 0;
+    }
+    return less;
+}
+
+/* r = a * b metodą Karatsuby, a i b długości n, r długości 2n.
+ * Dla a = a0 + a1 X, b = b0 + b1 X środkowy współczynnik to
+ * a0 b0 + a1 b1 - (a0 - a1)(b0 - b1), więc wystarczą trzy mnożenia
+ * połówek. Różnice są brane co do wartości bezwzględnej, aby nie
+ * wydłużać czynników o cyfrę przeniesienia */
+inline void mulKaratsuba(Limb *r, const Limb *a, const Limb *b, size_t n,
+                         Limb *scratch) {
+    size_t h = n / 2, k = n - h;
+    Limb *da = scratch, *db = da + k, *p = db + k, *t = p + 2 * k;
+    Limb *next = t + 2 * k + 1;
+
+    bool negative = absDiff(da, a, h, a + h, k) != absDiff(db, b, h, b + h, k);
+    mulN(r, a, b, h, next);
+    mulN(r + 2 * h, a + h, b + h, k, next);
+    mulN(p, da, db, k, next);
+
+    t[2 * k] = add(t, r + 2 * h, 2 * k, r, 2 * h);
+    Limb carry = negative ? add(t, t, 2 * k + 1, p, 2 * k)
+                          : sub(t, t, 2 * k + 1, p, 2 * k);
+    assert(carry == 0);
+    carry = add(r + h, r + h, 2 * n - h, t, 2 * k + 1);
+    assert(carry == 0);
+    (void) carry;
+}
+
+/* Wartości wielomianu a0 + a1 X + a2 X^2 (a0, a1 długości k, a2 długości s)
+ * w punktach 1, -1 i 2, każda długości k + 1. Wartość w -1 zapisywana jest
+ * co do wartości bezwzględnej, zwraca true, jeśli jest ujemna */
+inline bool evaluateToom3(Limb *p1, Limb *pm1, Limb *p2, const Limb *a,
+                          size_t k, size_t s) {
+    const Limb *a0 = a, *a1 = a + k, *a2 = a + 2 * k;
+    p1[k] = add(p1, a0, k, a2, s);   // a0 + a2
+    bool negative = p1[k] == 0 && compare(p1, a1, k) < 0;
+    if (negative) {
+        subN(pm1, a1, p1, k);
+        pm1[k] = 0;
+    } else {
+        pm1[k] = p1[k] - subN(pm1, p1, a1, k);
+    }
+    p1[k] += addN(p1, p1, a1, k);
+
+    std::copy(a0, a0 + k, p2);
+    p2[k] = addMul1(p2, a1, k, 2);
+    Limb carry = addMul1(p2, a2, s, 4);
+    carry = add1(p2 + s, p2 + s, k + 1 - s, carry);
+    assert(carry == 0);
+    (void) carry;
+    return negative;
+}
+
+/* Dodaje c długości len do r długości n od pozycji offset. Cyfry c, które
+ * nie mieszczą się w r, muszą być zerami */
+inline void addAt(Limb *r, size_t n, size_t offset, const Limb *c,
+                  size_t len) {
+    size_t fit = std::min(len, n - offset);
+    assert(std::all_of(c + fit, c + len, [](Limb x) { return x == 0; }));
+    Limb carry = add(r + offset, r + offset, n - offset, c, fit);
+    assert(carry == 0);
+    (void) carry;
+}
+
+/* r = a * b metodą Toom-3, a i b długości n, r długości 2n. Czynniki są
+ * dzielone na trzy części, iloczyn jest obliczany w punktach 0, 1, -1, 2
+ * i nieskończoności (pięć mnożeń części), a współczynniki odtwarzane
+ * ciągiem interpolacji Bodrato, w którym wszystkie wartości pośrednie są
+ * nieujemne */
+inline void mulToom3(Limb *r, const Limb *a, const Limb *b, size_t n,
+                     Limb *scratch) {
+    size_t k = (n + 2) / 3, s = n - 2 * k, m = k + 1, len = 2 * m;
+    Limb *p1 = scratch, *q1 = p1 + m, *pm1 = q1 + m, *qm1 = pm1 + m;
+    Limb *p2 = qm1 + m, *q2 = p2 + m;
+    Limb *v1 = q2 + m, *vm1 = v1 + len, *v2 = vm1 + len, *next = v2 + len;
+
+    bool negative = evaluateToom3(p1, pm1, p2, a, k, s) !=
+                    evaluateToom3(q1, qm1, q2, b, k, s);
+    mulN(v1, p1, q1, m, next);
+    mulN(vm1, pm1, qm1, m, next);
+    mulN(v2, p2, q2, m, next);
+    Limb *v0 = r, *vinf = r + 4 * k;
+    mulN(v0, a, b, k, next);
+    mulN(vinf, a + 2 * k, b + 2 * k, s, next);
+
+    /* v2 = (v2 - vm1) / 3, vm1 = (v1 - vm1) / 2 */
+    if (negative) {
+        addN(v2, v2, vm1, len);
+        addN(vm1, v1, vm1, len);
+    } else {
+        subN(v2, v2, vm1, len);
+        subN(vm1, v1, vm1, len);
+    }
+    divExactBy3(v2, len);
+    shiftRight1(vm1, len);
+    /* v1 = v1 - v0, v2 = (v2 - v1) / 2 - 2 vinf */
+    sub(v1, v1, len, v0, 2 * k);
+    subN(v2, v2, v1, len);
+    shiftRight1(v2, len);
+    sub(v2, v2, len, vinf, 2 * s);
+    sub(v2, v2, len, vinf, 2 * s);
+    /* v1 = v1 - vm1 - vinf, vm1 = vm1 - v2 */
+    subN(v1, v1, vm1, len);
+    sub(v1, v1, len, vinf, 2 * s);
+    subN(vm1, vm1, v2, len);
+
+    /* współczynniki przy X, X^2, X^3 to vm1, v1, v2 */
+    clear(r + 2 * k, 2 * k);
+    addAt(r, 2 * n, k, vm1, len);
+    addAt(r, 2 * n, 2 * k, v1, len);
+    addAt(r, 2 * n, 3 * k, v2, len);
+}
+
+/* Mnożenie transformatą liczbowo-teoretyczną (NTT). Współczynnikami
+ * wielomianów są 32-bitowe słowa cyfr czynników. Ich splot liczony jest
+ * modulo trzy liczby pierwsze postaci c 2^k + 1 mniejsze od 2^31,
+ * a współczynniki iloczynu odtwarzane z reszt chińskim twierdzeniem
+ * o resztach. Iloczyn trzech modułów przekracza 2^90, a współczynnik
+ * splotu jest mniejszy od 2^24 2^64, więc odtworzenie jest dokładne. */
+using Word = uint32_t;
+using DoubleWord = uint64_t;
+const unsigned WORD_BITS = 32;
+const size_t WORDS_PER_LIMB = LIMB_BITS / WORD_BITS;
+
+const Word NTT_P0 = 2013265921;         // 15 * 2^27 + 1
+const Word NTT_P1 = 469762049;          // 7 * 2^26 + 1
+const Word NTT_P2 = 2113929217;         // 63 * 2^25 + 1
+
+/* i-te słowo ciągu cyfr a */
+inline Word word(const Limb *a, size_t i) {
+    return static_cast<Word>(a[i / WORDS_PER_LIMB] >>
+                             (i % WORDS_PER_LIMB * WORD_BITS));
+}
+
+template <Word P>
+inline Word mulMod(Word a, Word b) {
+    return static_cast<Word>(static_cast<DoubleWord>(a) * b % P);
+}
+
+template <Word P>
+inline Word powMod(Word a, DoubleWord e) {
+    Word result = 1;
+    for (; e > 0; e >>= 1) {
+        if (e & 1)
+            result = mulMod<P>(result, a);
+        a = mulMod<P>(a, a);
+    }
+    return result;
+}
+
+/* Iloraz w 2^32 / P, dzięki któremu mnożenie przez stałą w modulo P
+ * obywa się bez dzielenia (metoda Shoupa) */
+template <Word P>
+inline Word shoup(Word w) {
+    return static_cast<Word>((static_cast<DoubleWord>(w) << WORD_BITS) / P);
+}
+
+/* x * w modulo P, ws = shoup(w) */
+template <Word P>
+inline Word mulShoup(Word x, Word w, Word ws) {
+    Word q = static_cast<Word>((static_cast<DoubleWord>(x) * ws) >> WORD_BITS);
+    Word r = x * w - q * P;             // modulo 2^32, wynik w [0, 2P)
+    return r >= P ? r - P : r;
+}
+
+/* Pierwiastki z jedności dla transformaty długości len: dla każdej
+ * potęgi dwójki h < len pod indeksami h..2h-1 leżą kolejne potęgi
+ * pierwiastka stopnia 2h z root^(len / 2h), gdzie root jest pierwiastkiem
+ * stopnia len; obok ilorazy Shoupa */
+template <Word P>
+inline void nttRoots(Word *w, Word *ws, size_t len, Word root) {
+    for (size_t h = len / 2; h >= 1; h /= 2) {
+        Word x = 1;
+        for (size_t j = 0; j < h; ++j) {
+            w[h + j] = x;
+            ws[h + j] = shoup<P>(x);
+            x = mulMod<P>(x, root);
+        }
+        root = mulMod<P>(root, root);
+    }
+}
+
+/* Transformata w miejscu (Gentleman-Sande), wynik w porządku odwróconych
+ * bitów indeksów */
+template <Word P>
+inline void nttForward(Word *a, size_t len, const Word *w, const Word *ws) {
+    for (size_t h = len / 2; h >= 1; h /= 2)
+        for (size_t i = 0; i < len; i += 2 * h)
+            for (size_t j = 0; j < h; ++j) {
+                Word u = a[i + j], v = a[i + j + h];
+                Word sum = u + v;
+                a[i + j] = sum >= P ? sum - P : sum;
+                a[i + j + h] = mulShoup<P>(u - v + P, w[h + j], ws[h + j]);
+            }
+}
+
+/* Transformata odwrotna (Cooley-Tukey) danych w porządku odwróconych
+ * bitów, bez dzielenia przez długość */
+template <Word P>
+inline void nttInverse(Word *a, size_t len, const Word *w, const Word *ws) {
+    for (size_t h = 1; h < len; h *= 2)
+        for (size_t i = 0; i < len; i += 2 * h)
+            for (size_t j = 0; j < h; ++j) {
+                Word u = a[i + j];
+                Word v = mulShoup<P>(a[i + j + h], w[h + j], ws[h + j]);
+                Word sum = u + v;
+                a[i + j] = sum >= P ? sum - P : sum;
+                a[i + j + h] = u >= v ? u - v : u + P - v;
+            }
+}
+
+/* c = splot słów a i b modulo P, a długości an słów, b długości bn słów,
+ * c i t długości len, w i ws długości len */
+template <Word P, Word G>
+inline void convolveMod(Word *c, const Limb *a, size_t an,
+                        const Limb *b, size_t bn, size_t len,
+                        Word *t, Word *w, Word *ws) {
+    for (size_t i = 0; i < len; ++i) {
+        c[i] = i < an ? word(a, i) % P : 0;
+        t[i] = i < bn ? word(b, i) % P : 0;
+    }
+    Word root = powMod<P>(G, (P - 1) / len);
+    nttRoots<P>(w, ws, len, root);
+    nttForward<P>(c, len, w, ws);
+    nttForward<P>(t, len, w, ws);
+
+    Word scale = powMod<P>(static_cast<Word>(len), P - 2);
+    Word scaleShoup = shoup<P>(scale);
+    for (size_t i = 0; i < len; ++i)
+        c[i] = mulShoup<P>(mulMod<P>(c[i], t[i]), scale, scaleShoup);
+
+    nttRoots<P>(w, ws, len, powMod<P>(root, P - 2));
+    nttInverse<P>(c, len, w, ws);
+}
+
+/* Długość transformaty dla iloczynu długości rn cyfr */
+inline size_t nttLength(size_t rn) {
+    size_t n = rn * WORDS_PER_LIMB, len = 1;
+    while (len < n - 1)
+        len *= 2;
+    return len;
+}
+
+/* Rozmiar (w słowach) bufora mulNtt dla iloczynu długości rn cyfr */
+inline size_t nttScratch(size_t rn) {
+    return 6 * nttLength(rn);
+}
+
+/* r = a * b transformatą, r długości an + bn <= NTT_MAX_LENGTH, nie może
+ * nachodzić na a ani b. buffer ma co najmniej nttScratch(an + bn) słów */
+inline void mulNtt(Limb *r, const Limb *a, size_t an,
+                   const Limb *b, size_t bn, Word *buffer) {
+    assert(an + bn <= NTT_MAX_LENGTH);
+    size_t n = (an + bn) * WORDS_PER_LIMB;
+    size_t len = nttLength(an + bn);
+
+    Word *c0 = buffer, *c1 = c0 + len, *c2 = c1 + len;
+    Word *t = c2 + len, *w = t + len, *ws = w + len;
+    an *= WORDS_PER_LIMB;
+    bn *= WORDS_PER_LIMB;
+    convolveMod<NTT_P0, 31>(c0, a, an, b, bn, len, t, w, ws);
+    convolveMod<NTT_P1, 3>(c1, a, an, b, bn, len, t, w, ws);
+    convolveMod<NTT_P2, 5>(c2, a, an, b, bn, len, t, w, ws);
+
+    /* Garner: x = x0 + P0 y1 + P0 P1 y2, najpierw x01 = x0 + P0 y1 */
+    const Word inv01 = powMod<NTT_P1>(NTT_P0 % NTT_P1, NTT_P1 - 2);
+    const DoubleWord p01 = static_cast<DoubleWord>(NTT_P0) * NTT_P1;
+    const Word inv012 = powMod<NTT_P2>(static_cast<Word>(p01 % NTT_P2),
+                                       NTT_P2 - 2);
+    const Word p01Low = static_cast<Word>(p01);
+    const Word p01High = static_cast<Word>(p01 >> WORD_BITS);
+    clear(r, n / WORDS_PER_LIMB);
+    DoubleWord carry = 0;
+    for (size_t i = 0; i < n; ++i) {
+        DoubleWord x01 = 0;
+        Word y2 = 0;
+        if (i < n - 1) {
+            Word x0 = c0[i], x1 = c1[i];
+            Word y1 = mulMod<NTT_P1>(x1 + NTT_P1 - x0 % NTT_P1, inv01);
+            x01 = x0 + static_cast<DoubleWord>(NTT_P0) * y1;
+            Word x01Mod = static_cast<Word>(x01 % NTT_P2);
+            Word diff = c2[i] >= x01Mod ? c2[i] - x01Mod
+                                        : c2[i] + NTT_P2 - x01Mod;
+            y2 = mulMod<NTT_P2>(diff, inv012);
+        }
+        /* carry + x01 + p01 y2, bez przepełnienia 64 bitów */
+        DoubleWord low = (carry & ~static_cast<Word>(0)) +
+                         static_cast<Word>(x01) +
+                         static_cast<DoubleWord>(p01Low) * y2;
+        r[i / WORDS_PER_LIMB] |= static_cast<Limb>(static_cast<Word>(low))
+                                 << (i % WORDS_PER_LIMB * WORD_BITS);
+        carry = (low >> WORD_BITS) + (carry >> WORD_BITS) +
+                (x01 >> WORD_BITS) + static_cast<DoubleWord>(p01High) * y2;
+    }
+    assert(carry == 0);
+}
+
+/* mulNtt z własnym buforem */
+inline void mulNtt(Limb *r, const Limb *a, size_t an,
+                   const Limb *b, size_t bn) {
+    std::vector<Word> buffer(nttScratch(an + bn));
+    mulNtt(r, a, an, b, bn, buffer.data());
+}
+
+/* r = a * b, a i b długości n, r długości 2n, nie może nachodzić na a ani
+ * b. scratch ma co najmniej mulScratch(n) cyfr */
+inline void mulN(Limb *r, const Limb *a, const Limb *b, size_t n,
+                 Limb *scratch) {
+    if (n < KARATSUBA_THRESHOLD)
+        mulBasecase(r, a, n, b, n);
+    else if (useNtt(n))
+        mulNtt(r, a, n, b, n);
+    else if (n < TOOM3_THRESHOLD)
+        mulKaratsuba(r, a, b, n, scratch);
+    else
+        mulToom3(r, a, b, n, scratch);
+}
+
+/* r = a * b, r długości an + bn, nie może nachodzić na a ani b. Dłuższy
+ * czynnik jest dzielony na kawałki długości krótszego, mnożone
+ * algorytmem dla równych długości */
+inline void multiply(Limb *r, const Limb *a, size_t an,
+                     const Limb *b, size_t bn) {
+    if (an < bn) {
+        std::swap(a, b);
+        std::swap(an, bn);
+    }
+    if (bn < KARATSUBA_THRESHOLD) {
+        mulBasecase(r, a, an, b, bn);
+        return;
+    }
+    if (bn >= NTT_THRESHOLD && an + bn <= NTT_MAX_LENGTH) {
+        mulNtt(r, a, an, b, bn);
+        return;
+    }
+    std::vector<Limb> scratch(2 * bn + mulScratch(bn));
+    Limb *product = scratch.data(), *next = product + 2 * bn;
+    mulN(r, a, b, bn, next);
+    clear(r + 2 * bn, an - bn);
+    for (size_t i = bn; i < an; i += bn) {
+        size_t len = std::min(bn, an - i);
+        if (len == bn)
+            mulN(product, a + i, b, bn, next);
+        else
+            multiply(product, b, bn, a + i, len);
+        Limb carry = add(r + i, r + i, an + bn - i, product, bn + len);
+        assert(carry == 0);
+        (void) carry;
+    }
+}
+
+}
+
+#endif
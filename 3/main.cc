@@ -2,10 +2,28 @@
 #include <sstream>
 #include <string>
 #include "very_long_int.h"
+#include "modular.h"
+#include "signed_very_long_int.h"
 #include <random>
 #include <climits>
+#include <cstdlib>
+#include <new>
 using namespace std;
 
+/* Liczba przydziałów pamięci na stercie w całym programie */
+size_t allocations = 0;
+
+void *operator new(size_t size) {
+    ++allocations;
+    if (void *p = malloc(size))
+        return p;
+    throw bad_alloc();
+}
+
+void operator delete(void *p) noexcept {
+    free(p);
+}
+
 void tests_from_the_content() {
     {
         VeryLongInt x = 1;
@@ -515,9 +533,359 @@ void smart_and_sneaky() {
     
 }
 
+/* Losowa liczba o podanej liczbie 32-bitowych cyfr */
+VeryLongInt random_number(mt19937 &rng, size_t components) {
+    VeryLongInt x = 0;
+    for (size_t i = 0; i < components; ++i) {
+        x <<= 32;
+        x += static_cast<unsigned>(rng());
+    }
+    return x;
+}
+
+void multiplication_algorithms() {
+    mt19937 rng(2015);
+
+    /* Długości po obu stronach progów Karatsuby, Toom-3 i transformaty,
+     * dla cyfr 32- i 64-bitowych */
+    for (size_t n : {1, 38, 39, 40, 41, 100, 159, 160, 161, 239, 240, 241,
+                     475, 500, 1499, 1500, 3000, 7999, 8000}) {
+        auto a = random_number(rng, n), b = random_number(rng, n);
+        auto c = random_number(rng, n);
+        assert((a + b) * c == a * c + b * c);
+        assert(a * b == b * a);
+        assert((a * b) % a == 0 && (a * b) / a == b);
+    }
+
+    /* Czynniki różnej długości */
+    for (size_t n : {1, 7, 50, 170, 777, 1600, 8000}) {
+        auto a = random_number(rng, 9000), b = random_number(rng, n);
+        auto c = random_number(rng, n);
+        assert(a * (b + c) == a * b + a * c);
+        assert(a * b == b * a);
+    }
+
+    /* Same jedynki: (2^n - 1)^2 = 2^2n - 2^(n+1) + 1 */
+    for (size_t n : {32, 1279, 5120, 32000, 64000, 3200000}) {
+        VeryLongInt one = 1;
+        auto x = (one << n) - 1;
+        assert(x * x == (one << 2 * n) - (one << (n + 1)) + 1);
+    }
+
+    {
+        auto x = random_number(rng, 300);
+        assert(x * 0 == 0);
+        assert(x * 1 == x);
+        assert(!(x * NaN()).isValid());
+    }
+}
+
+void division_algorithms() {
+    mt19937 rng(2016);
+    VeryLongInt one = 1;
+
+    /* Dzielniki jedno- i wielocyfrowe, dzielne różnej długości */
+    for (size_t y_len : {1, 2, 3, 10, 100, 700}) {
+        for (size_t extra : {0, 1, 5, 300}) {
+            auto y = random_number(rng, y_len) + 1;
+            auto x = random_number(rng, y_len + extra);
+            auto q = x / y, r = x % y;
+            assert(q * y + r == x);
+            assert(r < y);
+        }
+    }
+
+    /* Dzielnik o najstarszej cyfrze z jednym bitem i z samymi jedynkami,
+     * przy których przybliżenie cyfry ilorazu trzeba poprawiać */
+    for (size_t bits : {33, 64, 95, 96, 640}) {
+        auto y = one << (bits - 1), z = (one << bits) - 1;
+        auto x = (one << (3 * bits)) - 1;
+        assert(x / z == (one << 2 * bits) + (one << bits) + 1);
+        assert(x % z == 0);
+        assert(x / y == (one << (2 * bits + 1)) - 1);
+        assert(x % y == y - 1);
+        assert((x - 1) % z == z - 1);
+    }
+
+    {
+        auto x = random_number(rng, 50);
+        assert(x / x == 1 && x % x == 0);
+        assert(x / (x + 1) == 0 && x % (x + 1) == x);
+        assert(!(x / 0).isValid() && !(x % 0).isValid());
+        assert(!(x / NaN()).isValid() && !(NaN() % x).isValid());
+    }
+}
+
+/* Zapis dziesiętny liczby */
+string decimal(VeryLongInt const &x) {
+    stringstream s;
+    s << x;
+    return s.str();
+}
+
+void decimal_conversion() {
+    mt19937 rng(2017);
+
+    /* Potęgi dziesięciu, także dłuższe niż potęgi, przez które dzieli się
+     * metodą Barretta; zera w środku muszą zostać wypisane */
+    VeryLongInt power = 1;
+    size_t zeros = 0;
+    for (size_t k : {1, 8, 9, 10, 18, 19, 100, 1000, 20000, 60000}) {
+        for (; zeros < k; ++zeros)
+            power *= 10;
+        assert(decimal(power) == "1" + string(k, '0'));
+        assert(decimal(power - 1) == string(k, '9'));
+        assert(decimal(power + 1) == "1" + string(k - 1, '0') + "1");
+    }
+
+    for (size_t len : {1, 5, 9, 10, 300, 301, 3000}) {
+        string repr(1, '1' + rng() % 9);
+        while (repr.size() < len)
+            repr += '0' + rng() % 10;
+        assert(decimal(VeryLongInt(repr)) == repr);
+    }
+
+    assert(decimal(Zero()) == "0");
+    assert(decimal(NaN()) == "NaN");
+}
+
+void decimal_parsing() {
+    mt19937 rng(2018);
+
+    /* Odczyt długich zapisów, także dłuższych niż potęgi dzielące je na
+     * części, zgadza się z wartością liczoną mnożeniem */
+    VeryLongInt power = 1;
+    size_t zeros = 0;
+    for (size_t k : {8, 9, 10, 270, 271, 5000, 60000}) {
+        for (; zeros < k; ++zeros)
+            power *= 10;
+        assert(VeryLongInt("1" + string(k, '0')) == power);
+        assert(VeryLongInt(string(k, '9')) == power - 1);
+        assert(VeryLongInt(string(k, '0') + "7") == 7);
+        assert(VeryLongInt("3" + string(k, '0') + "2") == power * 30 + 2);
+    }
+
+    /* Niepoprawny znak w dowolnym miejscu daje NaN */
+    string repr(20000, '5');
+    for (size_t pos : {0, 1, 9, 270, 12345, 19999}) {
+        for (char c : {'a', ' ', '-', '/', ':', '\0'}) {
+            string bad = repr;
+            bad[pos] = c;
+            assert(!VeryLongInt(bad).isValid());
+        }
+    }
+
+    for (size_t i = 0; i < 100; ++i) {
+        uint64_t x = (static_cast<uint64_t>(rng()) << 32) | rng();
+        assert(VeryLongInt(to_string(x)) == x);
+    }
+}
+
+void small_values_without_allocation() {
+    VeryLongInt x = 123456789, y = 987654321000ULL;
+    size_t before = allocations;
+
+    /* wyniki mieszczą się w 128 bitach */
+    auto product = x * y, sum = product + x, difference = sum - y;
+    auto quotient = product / x, remainder = product % y;
+    auto shifted = (x << 90) >> 3;
+    VeryLongInt copy = product;
+    copy = move(sum);
+    bool less = quotient < remainder || shifted <= difference;
+
+    assert(allocations == before);
+    assert(product == VeryLongInt("121932631112635269000"));
+    assert(copy == VeryLongInt("121932631112758725789"));
+    assert(difference == VeryLongInt("121932630125104404789"));
+    assert(quotient == y && remainder == 0);
+    assert(shifted == x * (VeryLongInt(1) << 87));
+    assert(!less);
+}
+
+void fused_operations() {
+    mt19937 rng(48);
+    /* po obu stronach progów algorytmów mnożenia */
+    for (size_t n : {1, 3, 70, 200, 1000}) {
+        auto acc = random_number(rng, 2 * n + 5);
+        auto x = random_number(rng, n), y = random_number(rng, n / 2 + 1);
+        VeryLongInt expected = acc + x * y, sum = acc;
+        assert(sum.mulAdd(x, y) == expected);
+        assert(sum.mulSub(y, x) == acc);
+        VeryLongInt small = 1;
+        assert(small.mulAdd(x, y) == x * y + 1);
+        assert(small.mulSub(x, y) == 1);
+        assert(!VeryLongInt(1).mulSub(x, y).isValid() || x * y <= 1);
+    }
+
+    /* argument będący zmienianą liczbą */
+    auto a = random_number(rng, 30), b = random_number(rng, 30);
+    VeryLongInt expected = a + a * b;
+    assert(a.mulAdd(a, b) == expected);
+    expected = b - b * VeryLongInt(0);
+    assert(b.mulSub(b, VeryLongInt(0)) == expected);
+    VeryLongInt c = 5;
+    assert(!c.mulSub(c, c).isValid());
+
+    assert(!VeryLongInt(1).mulAdd(NaN(), 2).isValid());
+    VeryLongInt nan = NaN();
+    assert(!nan.mulAdd(1, 2).isValid());
+    assert(VeryLongInt(7).mulSub(2, 3) == 1);
+}
+
+/* x^e mod m przez kolejne mnożenie i dzielenie */
+VeryLongInt naive_pow_mod(VeryLongInt x, VeryLongInt e, VeryLongInt const &m) {
+    VeryLongInt res = VeryLongInt(1) % m;
+    for (; e; e >>= 1) {
+        if (e % 2 == 1)
+            res = res * x % m;
+        x = x * x % m;
+    }
+    return res;
+}
+
+void modular_arithmetic() {
+    mt19937 rng(49);
+    /* nieparzyste (Montgomery) i parzyste (Barrett) moduły, krótkie
+     * i powyżej progów mnożenia */
+    for (size_t n : {1, 2, 5, 40, 130, 400}) {
+        for (int parity : {0, 1}) {
+            auto m = random_number(rng, n) + 2;
+            if (m % 2 != parity)
+                m += 1;
+            ModularContext ctx(m);
+            auto x = random_number(rng, n + 3), y = random_number(rng, n);
+            assert(ctx.mulMod(x, y) == x * y % m);
+            auto xr = x % m;
+            assert(ctx.mulMod(xr, xr) == xr * xr % m);
+            auto e = random_number(rng, n < 40 ? 3 : 1);
+            assert(ctx.powMod(x, e) == naive_pow_mod(x, e, m));
+        }
+    }
+
+    /* m = B^k, dla którego stała Barretta nie mieści się w k + 1
+     * cyfrach */
+    for (size_t k : {1, 2, 7}) {
+        VeryLongInt m = VeryLongInt(1) << (limbs::LIMB_BITS * k);
+        ModularContext ctx(m);
+        auto x = random_number(rng, 5 * k), y = random_number(rng, 3 * k);
+        assert(ctx.mulMod(x, y) == x * y % m);
+        assert(ctx.powMod(x, 77) == naive_pow_mod(x, 77, m));
+    }
+
+    /* małe twierdzenie Fermata dla liczby pierwszej 2^127 - 1 */
+    VeryLongInt p = (VeryLongInt(1) << 127) - 1;
+    ModularContext fermat(p);
+    for (int a : {2, 3, 1000000007})
+        assert(fermat.powMod(a, p - 1) == 1);
+    assert(fermat.powMod(p + 5, p) == 5);
+
+    /* kolejne wywołania, także z mnożeniem transformatą, używają buforów
+     * obiektu; pamięć przydzielana jest tylko na wynik */
+    size_t len = limbs::NTT_THRESHOLD * limbs::LIMB_BITS / 32;
+    for (int parity : {0, 1}) {
+        auto m = random_number(rng, len);
+        if (m % 2 != parity)
+            m += 1;
+        ModularContext ctx(m);
+        auto x = random_number(rng, len) % m, y = random_number(rng, len) % m;
+        auto product = ctx.mulMod(x, y);
+        assert(product == x * y % m);
+        assert(ctx.powMod(x, 5) == x * x % m * x % m * x % m * x % m);
+        size_t before = allocations;
+        product = ctx.mulMod(y, x);
+        auto power = ctx.powMod(x, 5);
+        assert(allocations - before <= 2);
+        assert(product == x * y % m && power == ctx.powMod(x, 5));
+    }
+
+    ModularContext unit(1), ten(10);
+    assert(unit.powMod(7, 0) == 0 && unit.mulMod(3, 4) == 0);
+    assert(ten.powMod(7, 0) == 1 && ten.powMod(0, 0) == 1);
+    assert(ten.powMod(0, 5) == 0 && ten.powMod(7, 222) == 9);
+    assert(ten.mulMod(123, 456) == 8 && ten.modulus() == 10);
+    assert(!ten.mulMod(NaN(), 1).isValid());
+    assert(!ten.powMod(2, NaN()).isValid());
+}
+
+void signed_arithmetic() {
+    /* porównanie z long long na małych liczbach obu znaków */
+    mt19937 rng(50);
+    for (int i = 0; i < 2000; ++i) {
+        long long a = static_cast<int>(rng()) >> (rng() % 32);
+        long long b = static_cast<int>(rng()) >> (rng() % 32);
+        size_t k = rng() % 32;
+        SignedVeryLongInt x = a, y = b;
+        assert(x + y == a + b && x - y == a - b && x * y == a * b);
+        assert((x & y) == (a & b) && (x | y) == (a | b));
+        assert((x ^ y) == (a ^ b) && ~x == ~a && -x == -a);
+        assert((x >> k) == (a >> k) && (x << k) == a * (1LL << k));
+        assert((x < y) == (a < b) && (x == y) == (a == b));
+        if (b != 0)
+            assert(x / y == a / b && x % y == a % b);
+    }
+
+    /* tożsamości na długich liczbach, także przy przeniesieniu znaku
+     * na kolejną cyfrę */
+    for (size_t n : {1, 2, 5, 30}) {
+        SignedVeryLongInt x = random_number(rng, n), y = random_number(rng, n);
+        SignedVeryLongInt pow = SignedVeryLongInt(1) << (n * 32);
+        for (int signs = 0; signs < 4; ++signs) {
+            SignedVeryLongInt a = signs & 1 ? -x : x, b = signs & 2 ? -y : y;
+            assert((a & b) + (a | b) == a + b);
+            assert((a ^ b) == (a | b) - (a & b));
+            assert((a & ~a) == 0 && (a | ~a) == -1 && ~~a == a);
+            assert((a & (pow - 1)) == (a % pow + pow) % pow);
+            assert((a >> (n * 32)) * pow + (a & (pow - 1)) == a);
+        }
+        assert((-(pow - 1) & -2) == -pow && (-pow | (pow - 1)) == -1);
+    }
+
+    assert(SignedVeryLongInt("-123") * SignedVeryLongInt("-0") == 0);
+    SignedVeryLongInt minus_zero("-0");
+    assert(minus_zero == 0 && !minus_zero.isNegative());
+    assert(SignedVeryLongInt(LLONG_MIN).abs() == VeryLongInt(1ULL << 63));
+    assert(SignedVeryLongInt(3) - VeryLongInt(5) == -2);
+    assert(!SignedVeryLongInt("-").isValid());
+    assert(!SignedVeryLongInt("--1").isValid());
+    assert(!(SignedVeryLongInt(1) / 0).isValid());
+    assert(!(SignedVeryLongInt(1) & SignedVeryLongInt("x")).isValid());
+    stringstream s;
+    s << SignedVeryLongInt(-42) << " " << (SignedVeryLongInt(7) - 7);
+    assert(s.str() == "-42 0");
+
+    assert((VeryLongInt(1) << limbs::LIMB_BITS) >> limbs::LIMB_BITS == 1);
+    assert((VeryLongInt(5) >> limbs::LIMB_BITS) == 0);
+}
+
+/* Konstruktory ze znakiem nie zawijają liczb ujemnych do 2^64 - |x|, tylko
+ * dają NaN, tak jak ujemny wynik odejmowania */
+void negative_constructors() {
+    assert(!VeryLongInt(-1).isValid());
+    assert(!VeryLongInt(-1L).isValid());
+    assert(!VeryLongInt(-1LL).isValid());
+    assert(!VeryLongInt(INT_MIN).isValid());
+    assert(!VeryLongInt(LLONG_MIN).isValid());
+    VeryLongInt x = 7;
+    x = -3;
+    assert(!x.isValid());
+    assert(!(VeryLongInt(3) - VeryLongInt(5)).isValid());
+    assert(VeryLongInt(0) == 0 && VeryLongInt(-0L) == 0);
+    assert(VeryLongInt(INT_MAX) == 2147483647U);
+    assert(VeryLongInt(LLONG_MAX) + 1 == 1ULL << 63);
+}
+
 int main() {
 
     smart_and_sneaky();
+    multiplication_algorithms();
+    division_algorithms();
+    decimal_conversion();
+    decimal_parsing();
+    small_values_without_allocation();
+    fused_operations();
+    modular_arithmetic();
+    signed_arithmetic();
+    negative_constructors();
   {
       VeryLongInt x = 1000000;
       x -= 100000000000;
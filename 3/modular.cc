@@ -0,0 +1,224 @@
+#include "modular.h"
+
+#include <algorithm>
+
+using namespace std;
+
+namespace {
+    /* Długość m (w cyfrach), od której redukcja Barretta, licząca dwa
+     * iloczyny szybkim mnożeniem, wyprzedza kwadratową redukcję
+     * Montgomery'ego */
+    const size_t MONTGOMERY_THRESHOLD = 1600 * 32 / limbs::LIMB_BITS;
+
+    /* Szerokość okna potęgowania dla wykładnika o danej liczbie bitów */
+    size_t windowSize(size_t bits) {
+        static const size_t LIMITS[] = {7, 36, 140, 450, 1303};
+        size_t k = 1;
+        for (size_t limit : LIMITS)
+            if (bits > limit)
+                ++k;
+        return k;
+    }
+}
+
+struct ModularContext::Workspace {
+    size_t n, fixed;
+    vector<Limb> memory;
+    /* Bufor transformaty dla mnożeń długości n i n + 1 */
+    vector<limbs::Word> transform;
+    /* Iloczyn do redukcji, dwa bufory redukcji Barretta, bufor mulN i n
+     * cyfr na każdą z liczb wywołującego */
+    Limb *product, *quotient, *estimate, *scratch, *operands;
+
+    explicit Workspace(size_t n) : n(n) {
+        size_t scratch_len = max(limbs::mulScratch(n),
+                                 limbs::mulScratch(n + 1));
+        fixed = 3 * (2 * n + 2) + scratch_len;
+        if (limbs::useNtt(n) || limbs::useNtt(n + 1))
+            transform.resize(limbs::nttScratch(2 * n + 2));
+        reserve(2);
+    }
+
+    /* Zapewnia miejsce na count liczb wywołującego */
+    void reserve(size_t count) {
+        if (memory.size() < fixed + count * n)
+            memory.resize(fixed + count * n);
+        product = memory.data();
+        quotient = product + 2 * n + 2;
+        estimate = quotient + 2 * n + 2;
+        scratch = estimate + 2 * n + 2;
+        operands = memory.data() + fixed;
+    }
+};
+
+ModularContext::ModularContext(VeryLongInt const &m) :
+        m(m), n(m.digits.size()), inverse(0) {
+    assert(m.isValid() && m);
+    mod.assign(m.digits.begin(), m.digits.end());
+    mod.push_back(0);
+    montgomery = (mod[0] & 1) && n < MONTGOMERY_THRESHOLD;
+    workspace.reset(new Workspace(n));
+    VeryLongInt r = VeryLongInt(1) << (n * limbs::LIMB_BITS);
+    /* floor(B^(2n) / m) mieści się w n + 1 cyfrach, chyba że m jest
+     * potęgą B; wtedy mniejsza o jeden wartość wymaga najwyżej jednego
+     * odejmowania więcej */
+    VeryLongInt q = r * r / m;
+    mu.assign(n + 1, ~static_cast<Limb>(0));
+    if (q.digits.size() <= n + 1)
+        copy(q.digits.begin(), q.digits.end(), mu.begin());
+    one.resize(n);
+    if (montgomery) {
+        /* odwrotność modulo 2^3 to mod[0], każdy krok Newtona podwaja
+         * liczbę poprawnych bitów */
+        Limb x = mod[0];
+        for (size_t bits = 3; bits < limbs::LIMB_BITS; bits *= 2)
+            x *= 2 - mod[0] * x;
+        inverse = -x;
+        rSquared.resize(n);
+        load(rSquared.data(), r * r);
+        load(one.data(), r);
+    } else {
+        load(one.data(), 1);
+    }
+}
+
+ModularContext::~ModularContext() {}
+
+void ModularContext::load(Limb *r, VeryLongInt const &x) const {
+    if (x < m) {
+        copy(x.digits.begin(), x.digits.end(), r);
+        limbs::clear(r + x.digits.size(), n - x.digits.size());
+    } else {
+        load(r, x % m);
+    }
+}
+
+VeryLongInt ModularContext::store(const Limb *a) const {
+    VeryLongInt res;
+    res.digits.assign(a, a + n);
+    res.removeLeadingZeros();
+    return res;
+}
+
+void ModularContext::montgomeryReduce(Limb *r, Limb *t) const {
+    const Limb *b = mod.data();
+    /* zeruje kolejne najmłodsze cyfry t, dodając wielokrotności m */
+    Limb carry = 0;
+    for (size_t i = 0; i < n; ++i) {
+        Limb c = limbs::addMul1(t + i, b, n, t[i] * inverse);
+        carry += limbs::add1(t + i + n, t + i + n, n - i, c);
+    }
+    /* t / R < 2m */
+    if (carry != 0 || limbs::compare(t + n, b, n) >= 0)
+        limbs::subN(r, t + n, b, n);
+    else
+        copy(t + n, t + 2 * n, r);
+}
+
+void ModularContext::barrettReduce(Limb *r, const Limb *t,
+                                   Workspace &w) const {
+    const Limb *b = mod.data();
+    /* iloraz szacowany z dołu z najstarszych cyfr t, reszta liczona
+     * modulo B^(n+1) */
+    multiply(w.quotient, t + n - 1, mu.data(), n + 1, w);
+    multiply(w.estimate, w.quotient + n + 1, b, n + 1, w);
+    Limb *rest = w.estimate;
+    limbs::subN(rest, t, rest, n + 1);
+    while (limbs::compare(rest, b, n + 1) >= 0)
+        limbs::subN(rest, rest, b, n + 1);
+    copy(rest, rest + n, r);
+}
+
+void ModularContext::multiply(Limb *r, const Limb *a, const Limb *b,
+                              size_t len, Workspace &w) const {
+    if (limbs::useNtt(len))
+        limbs::mulNtt(r, a, len, b, len, w.transform.data());
+    else
+        limbs::mulN(r, a, b, len, w.scratch);
+}
+
+void ModularContext::mulReduce(Limb *r, const Limb *a, const Limb *b,
+                               Workspace &w) const {
+    multiply(w.product, a, b, n, w);
+    if (montgomery)
+        montgomeryReduce(r, w.product);
+    else
+        barrettReduce(r, w.product, w);
+}
+
+VeryLongInt ModularContext::mulMod(VeryLongInt const &x,
+                                   VeryLongInt const &y) {
+    if (!x.isValid() || !y.isValid())
+        return NaN();
+    Workspace &w = *workspace;
+    w.reserve(2);
+    Limb *a = w.operands, *b = a + n;
+    load(a, x);
+    load(b, y);
+    /* pojedynczy iloczyn nie opłaca się zamieniać na postać
+     * Montgomery'ego */
+    multiply(w.product, a, b, n, w);
+    barrettReduce(a, w.product, w);
+    return store(a);
+}
+
+VeryLongInt ModularContext::powMod(VeryLongInt const &x,
+                                   VeryLongInt const &e) {
+    if (!x.isValid() || !e.isValid())
+        return NaN();
+    size_t bits = e.numberOfBinaryDigits(), k = windowSize(bits);
+    size_t powers = static_cast<size_t>(1) << (k - 1);
+    auto bit = [&e](size_t i) {
+        return (e.digits[i / limbs::LIMB_BITS] >> (i % limbs::LIMB_BITS)) & 1;
+    };
+
+    /* g zawiera x, x^3, ..., x^(2^k - 1) */
+    Workspace &w = *workspace;
+    w.reserve(powers + 2);
+    Limb *g = w.operands, *acc = g + powers * n, *square = acc + n;
+    load(g, x);
+    if (montgomery)
+        mulReduce(g, g, rSquared.data(), w);
+    if (powers > 1)
+        mulReduce(square, g, g, w);
+    for (size_t i = 1; i < powers; ++i)
+        mulReduce(g + i * n, g + (i - 1) * n, square, w);
+
+    /* bity wykładnika od najstarszego; okno zaczyna się i kończy
+     * jedynką */
+    copy(one.begin(), one.end(), acc);
+    bool started = false;
+    size_t i = bits;
+    while (i > 0) {
+        if (!bit(i - 1)) {
+            if (started)
+                mulReduce(acc, acc, acc, w);
+            --i;
+            continue;
+        }
+        size_t low = i > k ? i - k : 0;
+        while (!bit(low))
+            ++low;
+        size_t value = 0;
+        for (size_t j = i; j > low; --j)
+            value = 2 * value + bit(j - 1);
+        const Limb *power = g + (value / 2) * n;
+        if (started) {
+            for (size_t j = low; j < i; ++j)
+                mulReduce(acc, acc, acc, w);
+            mulReduce(acc, acc, power, w);
+        } else {
+            copy(power, power + n, acc);
+            started = true;
+        }
+        i = low;
+    }
+
+    /* wyjście z reprezentacji Montgomery'ego: acc / R */
+    if (montgomery) {
+        copy(acc, acc + n, w.product);
+        limbs::clear(w.product + n, n);
+        montgomeryReduce(acc, w.product);
+    }
+    return store(acc);
+}
@@ -0,0 +1,77 @@
+#ifndef JNP1_MODULAR_H
+#define JNP1_MODULAR_H
+
+#include <memory>
+#include <vector>
+#include "very_long_int.h"
+
+/* Arytmetyka modulo ustalona liczba m. Stałe potrzebne do redukcji są
+ * liczone raz, w konstruktorze, a mnożenie i potęgowanie działają na
+ * cyfrach stałej długości, bez dzielenia i bez przydziałów pamięci
+ * w każdym kroku. Potęgowanie dla nieparzystego m redukuje metodą
+ * Montgomery'ego, a dla parzystego (i dla bardzo długich m) i przy
+ * pojedynczym mnożeniu metodą Barretta. Bufory obliczeń, także bufory
+ * transformaty dla bardzo długich m, należą do obiektu i są używane
+ * ponownie przez kolejne wywołania, więc mulMod i powMod zmieniają obiekt
+ * i z jednego obiektu nie może korzystać jednocześnie kilka wątków */
+class ModularContext {
+public:
+    /* m musi być dodatnie */
+    explicit ModularContext(VeryLongInt const &m);
+    ~ModularContext();
+
+    ModularContext(ModularContext const &) = delete;
+    ModularContext& operator=(ModularContext const &) = delete;
+
+    VeryLongInt const& modulus() const {
+        return m;
+    }
+
+    /* Zwraca x * y mod m albo NaN, jeśli x lub y jest NaN */
+    VeryLongInt mulMod(VeryLongInt const &x, VeryLongInt const &y);
+    /* Zwraca x^e mod m (x^0 = 1) albo NaN, jeśli x lub e jest NaN.
+     * Potęgowanie przesuwającym się oknem */
+    VeryLongInt powMod(VeryLongInt const &x, VeryLongInt const &e);
+
+private:
+    using Limb = limbs::Limb;
+
+    VeryLongInt m;
+    /* Długość m w cyfrach */
+    size_t n;
+    bool montgomery;
+    /* m dopełnione zerem do n + 1 cyfr */
+    std::vector<Limb> mod;
+    /* Montgomery: -m^(-1) mod 2^LIMB_BITS i R^2 mod m, gdzie R = B^n,
+     * B = 2^LIMB_BITS */
+    Limb inverse;
+    std::vector<Limb> rSquared;
+    /* Barrett, także dla pojedynczych mnożeń: floor(B^(2n) / m),
+     * n + 1 cyfr */
+    std::vector<Limb> mu;
+    /* Jedynka w reprezentacji używanej przy mnożeniu */
+    std::vector<Limb> one;
+
+    /* Bufory pomocnicze obliczeń */
+    struct Workspace;
+    std::unique_ptr<Workspace> workspace;
+
+    /* Zapisuje x mod m w n cyfrach od r */
+    void load(Limb *r, VeryLongInt const &x) const;
+    /* Zwraca liczbę zapisaną w n cyfrach od a */
+    VeryLongInt store(const Limb *a) const;
+    /* r = t / R mod m. t ma 2n cyfr, jest mniejsze od m R i zostaje
+     * zniszczone */
+    void montgomeryReduce(Limb *r, Limb *t) const;
+    /* r = a * b, a i b długości len, r długości 2 len */
+    void multiply(Limb *r, const Limb *a, const Limb *b, size_t len,
+                  Workspace &w) const;
+    /* r = t mod m. t ma 2n cyfr i jest mniejsze od m^2 */
+    void barrettReduce(Limb *r, const Limb *t, Workspace &w) const;
+    /* r = a * b w reprezentacji używanej przez powMod, a, b i r długości
+     * n. r może być a lub b */
+    void mulReduce(Limb *r, const Limb *a, const Limb *b,
+                   Workspace &w) const;
+};
+
+#endif
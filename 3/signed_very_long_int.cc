@@ -0,0 +1,208 @@
+#include "signed_very_long_int.h"
+
+#include <algorithm>
+
+using namespace std;
+
+SignedVeryLongInt::SignedVeryLongInt(long long num) : negative(num < 0) {
+    /* 0 - num bez przepełnienia także dla najmniejszego long long */
+    uint64_t bits = static_cast<uint64_t>(num);
+    magnitude = negative ? 0 - bits : bits;
+}
+
+SignedVeryLongInt::SignedVeryLongInt(string const &x) : negative(false) {
+    if (!x.empty() && x[0] == '-') {
+        magnitude = x.size() > 1 ? VeryLongInt(x.substr(1)) : NaN();
+        negative = true;
+        normalize();
+    } else {
+        magnitude = VeryLongInt(x);
+    }
+}
+
+void SignedVeryLongInt::normalize() {
+    if (!magnitude)
+        negative = false;
+}
+
+template <typename Op>
+SignedVeryLongInt& SignedVeryLongInt::bitwise(SignedVeryLongInt const &x,
+                                              Op op) {
+    if (!isValid() || !x.isValid()) {
+        magnitude = NaN();
+        negative = false;
+        return *this;
+    }
+    auto const &a = magnitude.digits, &b = x.magnitude.digits;
+    /* dodatkowa cyfra na bity znaku */
+    VeryLongInt::Digits r(max(a.size(), b.size()) + 1);
+    negative = limbs::bitwise(r.data(), r.size(), a.data(), a.size(),
+                              negative, b.data(), b.size(), x.negative, op);
+    magnitude.digits = move(r);
+    magnitude.removeLeadingZeros();
+    normalize();
+    return *this;
+}
+
+SignedVeryLongInt& SignedVeryLongInt::operator+=(SignedVeryLongInt const &x) {
+    if (negative == x.negative) {
+        magnitude += x.magnitude;
+    } else if (x.magnitude <= magnitude) {
+        magnitude -= x.magnitude;
+    } else {
+        /* wynik ma znak x; moduł liczony jednym odejmowaniem */
+        magnitude = x.magnitude - magnitude;
+        negative = x.negative;
+    }
+    normalize();
+    return *this;
+}
+
+SignedVeryLongInt& SignedVeryLongInt::operator-=(SignedVeryLongInt const &x) {
+    return *this += -x;
+}
+
+SignedVeryLongInt& SignedVeryLongInt::operator*=(SignedVeryLongInt const &x) {
+    magnitude *= x.magnitude;
+    negative = negative != x.negative;
+    normalize();
+    return *this;
+}
+
+SignedVeryLongInt& SignedVeryLongInt::operator/=(SignedVeryLongInt const &x) {
+    magnitude /= x.magnitude;
+    negative = negative != x.negative;
+    normalize();
+    return *this;
+}
+
+SignedVeryLongInt& SignedVeryLongInt::operator%=(SignedVeryLongInt const &x) {
+    magnitude %= x.magnitude;
+    normalize();
+    return *this;
+}
+
+SignedVeryLongInt& SignedVeryLongInt::operator&=(SignedVeryLongInt const &x) {
+    return bitwise(x, [](limbs::Limb a, limbs::Limb b) { return a & b; });
+}
+
+SignedVeryLongInt& SignedVeryLongInt::operator|=(SignedVeryLongInt const &x) {
+    return bitwise(x, [](limbs::Limb a, limbs::Limb b) { return a | b; });
+}
+
+SignedVeryLongInt& SignedVeryLongInt::operator^=(SignedVeryLongInt const &x) {
+    return bitwise(x, [](limbs::Limb a, limbs::Limb b) { return a ^ b; });
+}
+
+SignedVeryLongInt& SignedVeryLongInt::operator<<=(size_t x) {
+    magnitude <<= x;
+    return *this;
+}
+
+SignedVeryLongInt& SignedVeryLongInt::operator>>=(size_t x) {
+    if (negative) {
+        /* floor(-m / 2^x) = -((m - 1) / 2^x) - 1 */
+        magnitude -= 1;
+        magnitude >>= x;
+        magnitude += 1;
+    } else {
+        magnitude >>= x;
+    }
+    return *this;
+}
+
+SignedVeryLongInt SignedVeryLongInt::operator-() const {
+    SignedVeryLongInt res = *this;
+    res.negative = !negative;
+    res.normalize();
+    return res;
+}
+
+SignedVeryLongInt SignedVeryLongInt::operator~() const {
+    return -*this - 1;
+}
+
+bool operator<(SignedVeryLongInt const &x, SignedVeryLongInt const &y) {
+    if (!x.isValid() || !y.isValid())
+        return false;
+    if (x.negative != y.negative)
+        return x.negative;
+    return x.negative ? y.magnitude < x.magnitude
+                      : x.magnitude < y.magnitude;
+}
+
+bool operator==(SignedVeryLongInt const &x, SignedVeryLongInt const &y) {
+    return x.negative == y.negative && x.magnitude == y.magnitude;
+}
+
+bool operator!=(SignedVeryLongInt const &x, SignedVeryLongInt const &y) {
+    return x.isValid() && y.isValid() && !(x == y);
+}
+
+bool operator>(SignedVeryLongInt const &x, SignedVeryLongInt const &y) {
+    return y < x;
+}
+
+bool operator<=(SignedVeryLongInt const &x, SignedVeryLongInt const &y) {
+    return x.isValid() && y.isValid() && !(x > y);
+}
+
+bool operator>=(SignedVeryLongInt const &x, SignedVeryLongInt const &y) {
+    return x.isValid() && y.isValid() && !(x < y);
+}
+
+SignedVeryLongInt operator+(SignedVeryLongInt x, SignedVeryLongInt const &y) {
+    x += y;
+    return x;
+}
+
+SignedVeryLongInt operator-(SignedVeryLongInt x, SignedVeryLongInt const &y) {
+    x -= y;
+    return x;
+}
+
+SignedVeryLongInt operator*(SignedVeryLongInt x, SignedVeryLongInt const &y) {
+    x *= y;
+    return x;
+}
+
+SignedVeryLongInt operator/(SignedVeryLongInt x, SignedVeryLongInt const &y) {
+    x /= y;
+    return x;
+}
+
+SignedVeryLongInt operator%(SignedVeryLongInt x, SignedVeryLongInt const &y) {
+    x %= y;
+    return x;
+}
+
+SignedVeryLongInt operator&(SignedVeryLongInt x, SignedVeryLongInt const &y) {
+    x &= y;
+    return x;
+}
+
+SignedVeryLongInt operator|(SignedVeryLongInt x, SignedVeryLongInt const &y) {
+    x |= y;
+    return x;
+}
+
+SignedVeryLongInt operator^(SignedVeryLongInt x, SignedVeryLongInt const &y) {
+    x ^= y;
+    return x;
+}
+
+SignedVeryLongInt operator<<(SignedVeryLongInt x, size_t y) {
+    x <<= y;
+    return x;
+}
+
+SignedVeryLongInt operator>>(SignedVeryLongInt x, size_t y) {
+    x >>= y;
+    return x;
+}
+
+ostream &operator<<(ostream &out, SignedVeryLongInt const &x) {
+    if (x.negative)
+        out << '-';
+    return out << x.magnitude;
+}
@@ -0,0 +1,116 @@
+#ifndef JNP1_SIGNED_VERY_LONG_INT_H
+#define JNP1_SIGNED_VERY_LONG_INT_H
+
+#include <iostream>
+#include <string>
+#include "very_long_int.h"
+
+class SignedVeryLongInt;
+
+bool operator!=(SignedVeryLongInt const &x, SignedVeryLongInt const &y);
+bool operator>(SignedVeryLongInt const &x, SignedVeryLongInt const &y);
+bool operator<=(SignedVeryLongInt const &x, SignedVeryLongInt const &y);
+bool operator>=(SignedVeryLongInt const &x, SignedVeryLongInt const &y);
+SignedVeryLongInt operator+(SignedVeryLongInt x, SignedVeryLongInt const &y);
+SignedVeryLongInt operator-(SignedVeryLongInt x, SignedVeryLongInt const &y);
+SignedVeryLongInt operator*(SignedVeryLongInt x, SignedVeryLongInt const &y);
+SignedVeryLongInt operator/(SignedVeryLongInt x, SignedVeryLongInt const &y);
+SignedVeryLongInt operator%(SignedVeryLongInt x, SignedVeryLongInt const &y);
+SignedVeryLongInt operator&(SignedVeryLongInt x, SignedVeryLongInt const &y);
+SignedVeryLongInt operator|(SignedVeryLongInt x, SignedVeryLongInt const &y);
+SignedVeryLongInt operator^(SignedVeryLongInt x, SignedVeryLongInt const &y);
+SignedVeryLongInt operator<<(SignedVeryLongInt x, size_t y);
+SignedVeryLongInt operator>>(SignedVeryLongInt x, size_t y);
+
+/* Liczba całkowita ze znakiem, trzymana jako moduł (VeryLongInt) i znak.
+ * Dzielenie zaokrągla w stronę zera, a reszta ma znak dzielnej, jak dla
+ * wbudowanych typów. Operacje bitowe i przesunięcie w prawo działają tak,
+ * jakby liczba była zapisana w kodzie uzupełnień do dwóch z nieskończenie
+ * wieloma bitami znaku. NaN (moduł NaN) powstaje z niepoprawnego napisu
+ * i z dzielenia przez zero, i przenosi się na wyniki */
+class SignedVeryLongInt {
+private:
+    VeryLongInt magnitude;
+    /* Nigdy dla zera ani NaN */
+    bool negative;
+
+    /* Zero i NaN nie mają znaku */
+    void normalize();
+    /* *this = *this op x w kodzie uzupełnień do dwóch, op działa na
+     * cyfrach */
+    template <typename Op>
+    SignedVeryLongInt& bitwise(SignedVeryLongInt const &x, Op op);
+
+public:
+    SignedVeryLongInt() : SignedVeryLongInt(0) {}
+    SignedVeryLongInt(long long num);
+    SignedVeryLongInt(int num) :
+        SignedVeryLongInt(static_cast<long long>(num)) {}
+    SignedVeryLongInt(long num) :
+        SignedVeryLongInt(static_cast<long long>(num)) {}
+    SignedVeryLongInt(unsigned num) : magnitude(num), negative(false) {}
+    SignedVeryLongInt(unsigned long num) :
+        magnitude(static_cast<uint64_t>(num)), negative(false) {}
+    SignedVeryLongInt(unsigned long long num) :
+        magnitude(num), negative(false) {}
+    SignedVeryLongInt(VeryLongInt x) :
+        magnitude(std::move(x)), negative(false) {}
+
+    /* Napis jak dla VeryLongInt, z opcjonalnym minusem na początku */
+    explicit SignedVeryLongInt(std::string const &x);
+    explicit SignedVeryLongInt(const char* x) :
+        SignedVeryLongInt(std::string(x)) {}
+
+    explicit SignedVeryLongInt(char c) = delete;
+    explicit SignedVeryLongInt(signed char c) = delete;
+    explicit SignedVeryLongInt(unsigned char c) = delete;
+    explicit SignedVeryLongInt(char16_t c) = delete;
+    explicit SignedVeryLongInt(char32_t c) = delete;
+    explicit SignedVeryLongInt(wchar_t c) = delete;
+    explicit SignedVeryLongInt(bool b) = delete;
+
+    SignedVeryLongInt& operator+=(SignedVeryLongInt const &x);
+    SignedVeryLongInt& operator-=(SignedVeryLongInt const &x);
+    SignedVeryLongInt& operator*=(SignedVeryLongInt const &x);
+    SignedVeryLongInt& operator/=(SignedVeryLongInt const &x);
+    SignedVeryLongInt& operator%=(SignedVeryLongInt const &x);
+
+    SignedVeryLongInt& operator&=(SignedVeryLongInt const &x);
+    SignedVeryLongInt& operator|=(SignedVeryLongInt const &x);
+    SignedVeryLongInt& operator^=(SignedVeryLongInt const &x);
+
+    SignedVeryLongInt& operator<<=(size_t x);
+    /* Zaokrągla w dół, czyli w stronę minus nieskończoności */
+    SignedVeryLongInt& operator>>=(size_t x);
+
+    SignedVeryLongInt operator-() const;
+    /* ~x = -x - 1 */
+    SignedVeryLongInt operator~() const;
+
+    explicit operator bool() const {
+        return static_cast<bool>(magnitude);
+    }
+
+    /* Zwraca false jeżeli liczba jest NaN */
+    bool isValid() const {
+        return magnitude.isValid();
+    }
+
+    bool isNegative() const {
+        return negative;
+    }
+
+    /* Wartość bezwzględna */
+    VeryLongInt const& abs() const {
+        return magnitude;
+    }
+
+    friend bool operator<(SignedVeryLongInt const &x,
+                          SignedVeryLongInt const &y);
+    friend bool operator==(SignedVeryLongInt const &x,
+                           SignedVeryLongInt const &y);
+    friend std::ostream &operator<<(std::ostream &out,
+                                    SignedVeryLongInt const &x);
+};
+
+#endif
@@ -0,0 +1,204 @@
+#ifndef JNP1_SMALL_VECTOR_H
+#define JNP1_SMALL_VECTOR_H
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <cstring>
+#include <initializer_list>
+#include <iterator>
+#include <new>
+#include <type_traits>
+
+/* Wektor, który pierwsze N elementów trzyma w sobie, a na stercie
+ * przydziela pamięć dopiero dla dłuższych ciągów. Elementy muszą dać
+ * się kopiować bajt po bajcie (jak cyfry liczby), dzięki czemu
+ * przenoszenie i poszerzanie to memcpy. Obsługuje tę część interfejsu
+ * std::vector, której używa VeryLongInt. */
+template <typename T, size_t N>
+class SmallVector {
+    static_assert(std::is_trivially_copyable<T>::value,
+                  "elementy SmallVector muszą być kopiowalne bajt po bajcie");
+    static_assert(N > 0, "SmallVector musi mieć miejsce na element");
+
+public:
+    using value_type = T;
+    using iterator = T *;
+    using const_iterator = const T *;
+    using reverse_iterator = std::reverse_iterator<iterator>;
+    using const_reverse_iterator = std::reverse_iterator<const_iterator>;
+
+    SmallVector() : first(local), length(0), capacity_(N) {}
+
+    explicit SmallVector(size_t n) : SmallVector() {
+        resize(n);
+    }
+
+    SmallVector(std::initializer_list<T> values) : SmallVector() {
+        assign(values.begin(), values.end());
+    }
+
+    SmallVector(SmallVector const &x) : SmallVector() {
+        assign(x.begin(), x.end());
+    }
+
+    /* Długi ciąg przejmuje razem z pamięcią, krótki kopiuje. x zostaje
+     * pusty, tak jak przeniesiony std::vector */
+    SmallVector(SmallVector &&x) : SmallVector() {
+        steal(x);
+    }
+
+    ~SmallVector() {
+        release();
+    }
+
+    SmallVector& operator=(SmallVector const &x) {
+        if (this != &x)
+            assign(x.begin(), x.end());
+        return *this;
+    }
+
+    SmallVector& operator=(SmallVector &&x) {
+        if (this != &x) {
+            release();
+            first = local;
+            capacity_ = N;
+            steal(x);
+        }
+        return *this;
+    }
+
+    template <typename It>
+    void assign(It begin, It end) {
+        size_t n = std::distance(begin, end);
+        length = 0;
+        reserve(n);
+        std::copy(begin, end, first);
+        length = n;
+    }
+
+    size_t size() const { return length; }
+    size_t capacity() const { return capacity_; }
+    bool empty() const { return length == 0; }
+
+    T *data() { return first; }
+    const T *data() const { return first; }
+
+    T& operator[](size_t i) { return first[i]; }
+    const T& operator[](size_t i) const { return first[i]; }
+
+    T& back() { return first[length - 1]; }
+    const T& back() const { return first[length - 1]; }
+    T& front() { return first[0]; }
+    const T& front() const { return first[0]; }
+
+    iterator begin() { return first; }
+    iterator end() { return first + length; }
+    const_iterator begin() const { return first; }
+    const_iterator end() const { return first + length; }
+    reverse_iterator rbegin() { return reverse_iterator(end()); }
+    reverse_iterator rend() { return reverse_iterator(begin()); }
+    const_reverse_iterator rbegin() const {
+        return const_reverse_iterator(end());
+    }
+    const_reverse_iterator rend() const {
+        return const_reverse_iterator(begin());
+    }
+
+    void reserve(size_t n) {
+        if (n > capacity_)
+            reallocate(std::max(n, 2 * capacity_));
+    }
+
+    /* Nowe elementy są zerowane */
+    void resize(size_t n, T const &value = T()) {
+        T copy = value;
+        reserve(n);
+        if (n > length)
+            std::fill(first + length, first + n, copy);
+        length = n;
+    }
+
+    void push_back(T const &value) {
+        if (length == capacity_) {
+            T copy = value;          // value może leżeć w tym wektorze
+            reallocate(2 * capacity_);
+            first[length++] = copy;
+        } else {
+            first[length++] = value;
+        }
+    }
+
+    void clear() {
+        length = 0;
+    }
+
+    iterator insert(const_iterator pos, size_t count, T const &value) {
+        size_t at = pos - first;
+        T copy = value;
+        reserve(length + count);
+        std::memmove(first + at + count, first + at,
+                     (length - at) * sizeof(T));
+        std::fill(first + at, first + at + count, copy);
+        length += count;
+        return first + at;
+    }
+
+    iterator erase(const_iterator from, const_iterator to) {
+        size_t at = from - first, count = to - from;
+        std::memmove(first + at, first + at + count,
+                     (length - at - count) * sizeof(T));
+        length -= count;
+        return first + at;
+    }
+
+    friend bool operator==(SmallVector const &x, SmallVector const &y) {
+        return x.length == y.length &&
+               std::equal(x.begin(), x.end(), y.begin());
+    }
+
+    friend bool operator!=(SmallVector const &x, SmallVector const &y) {
+        return !(x == y);
+    }
+
+private:
+    T *first;                            // local albo pamięć na stercie
+    size_t length;
+    size_t capacity_;
+    T local[N];
+
+    bool onHeap() const {
+        return first != local;
+    }
+
+    void release() {
+        if (onHeap())
+            ::operator delete(first);
+    }
+
+    void reallocate(size_t n) {
+        assert(n >= length);
+        T *memory = static_cast<T *>(::operator new(n * sizeof(T)));
+        std::memcpy(memory, first, length * sizeof(T));
+        release();
+        first = memory;
+        capacity_ = n;
+    }
+
+    /* Przejmuje zawartość x. Ten wektor musi być pusty i trzymać dane
+     * u siebie */
+    void steal(SmallVector &x) {
+        if (x.onHeap()) {
+            first = x.first;
+            capacity_ = x.capacity_;
+            x.first = x.local;
+            x.capacity_ = N;
+        } else {
+            std::memcpy(local, x.local, x.length * sizeof(T));
+        }
+        length = x.length;
+        x.length = 0;
+    }
+};
+
+#endif
@@ -4,10 +4,91 @@
 #include <cstdlib>
 #include <iostream>
 #include <iterator>
-#include <sstream>
+#include <limits>
 
 using namespace std;
 
+namespace {
+    constexpr limbs::Limb power10(size_t n) {
+        return n == 0 ? 1 : 10 * power10(n - 1);
+    }
+
+    /* Najwięcej cyfr dziesiętnych, których wartość mieści się w cyfrze
+     * liczby (19 dla cyfr 64-bitowych), i ich podstawa */
+    const size_t CHUNK_DIGITS = numeric_limits<limbs::Limb>::digits10;
+    const limbs::Limb CHUNK_BASE = power10(CHUNK_DIGITS);
+
+    /* Długość liczby (w cyfrach), do której zapis dziesiętny powstaje
+     * przez kolejne dzielenie przez CHUNK_BASE, a odczytywany jest
+     * mnożeniem przez CHUNK_BASE, i długość potęgi dziesięciu, od której
+     * dzieli się przez nią metodą Barretta */
+    const size_t DECIMAL_THRESHOLD = 30 * 32 / limbs::LIMB_BITS;
+    const size_t BARRETT_THRESHOLD = 2000 * 32 / limbs::LIMB_BITS;
+
+    /* Zwraca floor(2^shift / d) dla d > 0. Przybliżenie z dołu, obliczone
+     * rekurencyjnie z najstarszej połowy bitów d, jest poprawiane jednym
+     * krokiem Newtona x' = x (2^(shift+1) - d x) / 2^shift, który podwaja
+     * liczbę dokładnych bitów i nie przeskakuje wyniku. Pozostały błąd
+     * o kilka jednostek usuwa krótkie dzielenie reszty */
+    VeryLongInt reciprocal(VeryLongInt const &d, size_t shift) {
+        const VeryLongInt one = 1;
+        size_t bits = d.numberOfBinaryDigits();
+        if (bits <= 64 || shift < bits + 64)
+            return (one << shift) / d;
+        size_t low = bits / 2;
+        VeryLongInt x = reciprocal((d >> low) + 1, shift - 2 * low) << low;
+        x = (x * ((one << (shift + 1)) - d * x)) >> shift;
+        return x + ((one << shift) - d * x) / d;
+    }
+}
+
+/* values[k] = 10^(CHUNK_DIGITS 2^k). Dla potęg długich co najmniej
+ * BARRETT_THRESHOLD cyfr pamiętane jest też reciprocals[k] =
+ * floor(2^shifts[k] / values[k]), które zastępuje dzielenie mnożeniem */
+struct VeryLongInt::DecimalPowers {
+    vector<VeryLongInt> values;
+    vector<VeryLongInt> reciprocals;
+    vector<size_t> shifts;
+
+    /* Liczba zer potęgi values[k] */
+    static size_t exponent(size_t k) {
+        return CHUNK_DIGITS << k;
+    }
+
+    VeryLongInt const &value(size_t k) {
+        while (values.size() <= k) {
+            if (values.empty())
+                values.push_back(CHUNK_BASE);
+            else
+                values.push_back(values.back() * values.back());
+        }
+        return values[k];
+    }
+
+    /* Zwraca parę <x / values[k], x % values[k]>, x < values[k]^2 */
+    tuple<VeryLongInt, VeryLongInt> split(VeryLongInt const &x, size_t k) {
+        VeryLongInt const &p = value(k);
+        if (p.digits.size() < BARRETT_THRESHOLD)
+            return divMod(x, p);
+        if (reciprocals.size() <= k) {
+            reciprocals.resize(k + 1, NaN());
+            shifts.resize(k + 1);
+        }
+        if (!reciprocals[k].isValid()) {
+            shifts[k] = 2 * p.numberOfBinaryDigits();
+            reciprocals[k] = reciprocal(p, shifts[k]);
+        }
+        /* iloraz przybliżony z dołu najwyżej o 2 */
+        VeryLongInt quotient = (x * reciprocals[k]) >> shifts[k];
+        VeryLongInt remainder = x - quotient * p;
+        while (remainder >= p) {
+            remainder -= p;
+            quotient += 1;
+        }
+        return make_tuple(move(quotient), move(remainder));
+    }
+};
+
 bool operator!=(VeryLongInt const &x, VeryLongInt const &y) {
     return x.isValid() && y.isValid() && !(x == y);
 }
@@ -24,51 +105,96 @@ bool operator>=(VeryLongInt const &x, VeryLongInt const &y) {
     return x.isValid() && y.isValid() && !(x < y);
 }
 
-const VeryLongInt operator+(VeryLongInt x, VeryLongInt const &y) {
-    return x += y;
+VeryLongInt operator+(VeryLongInt x, VeryLongInt const &y) {
+    x += y;
+    return x;
 }
 
-const VeryLongInt operator-(VeryLongInt x, VeryLongInt const &y) {
-    return x -= y;
+VeryLongInt operator-(VeryLongInt x, VeryLongInt const &y) {
+    x -= y;
+    return x;
 }
 
-const VeryLongInt operator*(VeryLongInt x, VeryLongInt const &y) {
-    return x *= y;
+VeryLongInt operator*(VeryLongInt x, VeryLongInt const &y) {
+    x *= y;
+    return x;
 }
 
-const VeryLongInt operator/(VeryLongInt x, VeryLongInt const &y) {
-    return x /= y;
+VeryLongInt operator/(VeryLongInt x, VeryLongInt const &y) {
+    x /= y;
+    return x;
 }
 
-const VeryLongInt operator%(VeryLongInt x, VeryLongInt const &y) {
-    return x %= y;
+VeryLongInt operator%(VeryLongInt x, VeryLongInt const &y) {
+    x %= y;
+    return x;
 }
 
-const VeryLongInt operator<<(VeryLongInt x, size_t y) {
-    return x <<= y;
+VeryLongInt operator<<(VeryLongInt x, size_t y) {
+    x <<= y;
+    return x;
 }
 
-const VeryLongInt operator>>(VeryLongInt x, size_t y) {
-    return x >>= y;
+VeryLongInt operator>>(VeryLongInt x, size_t y) {
+    x >>= y;
+    return x;
 }
 
 VeryLongInt::VeryLongInt(uint64_t x) {
     digits.push_back(static_cast<Component>(x));
-    auto rest = static_cast<Component>(x >> 32);
+    /* przy cyfrach 32-bitowych starsza połowa x trafia do drugiej cyfry */
+    auto rest = static_cast<Component>((x >> (USED_DIGITS - 1)) >> 1);
     if (rest > 0)
         digits.push_back(rest);
 }
 
+VeryLongInt::VeryLongInt(long long x) :
+        VeryLongInt(static_cast<uint64_t>(x)) {
+    if (x < 0)
+        *this = NaN();
+}
+
 VeryLongInt::VeryLongInt(string const &x) : VeryLongInt(0) {
-    /* Zapisujemy znak po znaku. */
-    for (auto c : x) {
-        if ('0' <= c && c <= '9') {
-            *this *= 10;
-            *this += c - '0';
-        } else {
-            *this = NaN();
-            break;
+    auto is_digit = [](char c) { return '0' <= c && c <= '9'; };
+    if (!all_of(begin(x), end(x), is_digit)) {
+        *this = NaN();
+    } else if (!x.empty()) {
+        DecimalPowers powers;
+        *this = readDecimal(x.data(), x.size(), powers);
+    }
+}
+
+VeryLongInt VeryLongInt::readDecimal(char const *s, size_t len,
+                                     DecimalPowers &powers) {
+    if (len <= DECIMAL_THRESHOLD * CHUNK_DIGITS) {
+        /* dokleja po CHUNK_DIGITS cyfr, pierwszy kawałek jest krótszy */
+        VeryLongInt result = 0;
+        result.digits.reserve(len / CHUNK_DIGITS + 1);
+        size_t chunk = (len - 1) % CHUNK_DIGITS + 1;
+        for (char const *end = s + len; s < end; chunk = CHUNK_DIGITS) {
+            Component value = 0, scale = 1;
+            for (size_t i = 0; i < chunk; ++i, ++s) {
+                value = value * 10 + (*s - '0');
+                scale *= 10;
+            }
+            auto &d = result.digits;
+            Component top = limbs::mul1(d.data(), d.data(), d.size(), scale);
+            top += limbs::add1(d.data(), d.data(), d.size(), value);
+            if (top != 0)
+                d.push_back(top);
         }
+        return result;
+    } else {
+        /* dzieli na młodsze cyfry, których jest tyle, ile zer największej
+         * potęgi krótszej od zapisu, i starsze */
+        size_t k = 0;
+        while (DecimalPowers::exponent(k + 1) < len)
+            ++k;
+        size_t low = DecimalPowers::exponent(k);
+        VeryLongInt result = readDecimal(s, len - low, powers);
+        result *= powers.value(k);
+        result += readDecimal(s + len - low, low, powers);
+        return result;
     }
 }
 
@@ -100,22 +226,11 @@ VeryLongInt& VeryLongInt::operator+=(VeryLongInt const &x) {
         *this = NaN();
     } else {
         digits.resize(max(digits.size(), x.digits.size()));
-        size_t len = x.digits.size();
-        uint64_t carry = 0;  /* ile dodatkowo dodać w następnej pozycji */
-        for (size_t i = 0; i < len; ++i) {
-            Component a = digits[i];
-            Component b = x.digits[i];
-            auto sum = carry + static_cast<uint64_t>(a) + b;
-            digits[i] = static_cast<Component>(sum);
-            carry = sum >> USED_DIGITS;
-        }
-        for (size_t i = len; i < digits.size(); ++i) {
-            uint64_t sum = carry + digits[i];
-            digits[i] = static_cast<Component>(sum);
-            carry = sum >> USED_DIGITS;
-        }
+        Component carry = limbs::add(digits.data(), digits.data(),
+                                     digits.size(), x.digits.data(),
+                                     x.digits.size());
         if (carry != 0)
-            digits.push_back(static_cast<Component>(carry));
+            digits.push_back(carry);
         assert(digits.size() == 1 || digits.back() != 0);
     }
     return *this;
@@ -125,26 +240,10 @@ VeryLongInt& VeryLongInt::operator-=(VeryLongInt const &x) {
     if (!isValid() || !x.isValid() || (digits.size() < x.digits.size())) {
         *this = NaN();
     } else {
-        uint64_t carry = 0;  /* ile dodatkowo odjąć w następnej pozycji */
-        for (size_t i = 0; i < x.digits.size(); ++i) {
-            uint64_t a = digits[i];
-            uint64_t b = carry + x.digits[i];
-            if (a < b) {
-                digits[i] = a + (BASE - b);
-                carry = 1;
-            } else {
-                digits[i] -= b;
-                carry = 0;
-            }
-        }
-        for (size_t i = x.digits.size(); i < digits.size(); ++i) {
-            if (digits[i] < carry) {
-                digits[i] = BASE - 1;
-            } else {
-                digits[i] -= carry;
-                carry = 0;
-            }
-        }
+        /* ile dodatkowo odjąć za najstarszą cyfrą */
+        Component carry = limbs::sub(digits.data(), digits.data(),
+                                     digits.size(), x.digits.data(),
+                                     x.digits.size());
         if (carry > 0)
             *this = NaN();
         removeLeadingZeros();
@@ -152,22 +251,6 @@ VeryLongInt& VeryLongInt::operator-=(VeryLongInt const &x) {
     return *this;
 }
 
-VeryLongInt VeryLongInt::multiplyByComponent(Component x) const {
-    assert(isValid());
-    VeryLongInt result = Zero();
-    size_t orig_len = digits.size();
-    result.digits.resize(orig_len + 1);
-    uint64_t carry = 0;      /* ile dodatkowo dodać w następnej pozycji */
-    for (size_t i = 0; i < orig_len; ++i) {
-        auto tmp = static_cast<uint64_t>(digits[i]) * x + carry;
-        result.digits[i] = static_cast<Component>(tmp);
-        carry = tmp >> USED_DIGITS;
-    }
-    result.digits[orig_len] = carry;
-    result.removeLeadingZeros();
-    return result;
-}
-
 void VeryLongInt::shiftByComponentsSize(size_t shift) {
     if (*this != Zero())
         digits.insert(begin(digits), shift, static_cast<Component>(0));
@@ -177,14 +260,62 @@ VeryLongInt& VeryLongInt::operator*=(VeryLongInt const &x) {
     if (!isValid() || !x.isValid()) {
         *this = NaN();
     } else {
-        auto result = Zero();
-        for (size_t shift = 0; shift < x.digits.size(); ++shift) {
-            auto partial = this->multiplyByComponent(x.digits[shift]);
-            partial.shiftByComponentsSize(shift);
-            result += partial;
-        }
-        *this = move(result);
+        /* szkolnie, Karatsubą lub Toom-3, zależnie od długości */
+        Digits result(digits.size() + x.digits.size());
+        limbs::multiply(result.data(), digits.data(), digits.size(),
+                        x.digits.data(), x.digits.size());
+        digits = move(result);
+        removeLeadingZeros();
+    }
+    return *this;
+}
+
+bool VeryLongInt::addProduct(VeryLongInt const &x, VeryLongInt const &y,
+                             bool subtract) {
+    Digits const *a = &x.digits, *b = &y.digits;
+    if (a->size() < b->size())
+        swap(a, b);
+    size_t product_len = a->size() + b->size();
+    size_t len = max(digits.size(), product_len) + 1;
+    bool aliased = this == &x || this == &y;
+    Component carry;
+    if (b->size() < limbs::KARATSUBA_THRESHOLD && !aliased) {
+        /* iloczyn dodawany wierszami prosto do wyniku */
+        digits.resize(len);
+        carry = subtract
+            ? limbs::subMulBasecase(digits.data(), len, a->data(), a->size(),
+                                    b->data(), b->size())
+            : limbs::addMulBasecase(digits.data(), len, a->data(), a->size(),
+                                    b->data(), b->size());
+    } else {
+        Digits product(product_len);
+        limbs::multiply(product.data(), a->data(), a->size(), b->data(),
+                        b->size());
+        digits.resize(len);
+        carry = subtract
+            ? limbs::sub(digits.data(), digits.data(), len, product.data(),
+                         product_len)
+            : limbs::add(digits.data(), digits.data(), len, product.data(),
+                         product_len);
     }
+    removeLeadingZeros();
+    /* wynik dodawania mieści się w len cyfrach */
+    assert(subtract || carry == 0);
+    return carry == 0;
+}
+
+VeryLongInt& VeryLongInt::mulAdd(VeryLongInt const &x, VeryLongInt const &y) {
+    if (!isValid() || !x.isValid() || !y.isValid())
+        *this = NaN();
+    else
+        addProduct(x, y, false);
+    return *this;
+}
+
+VeryLongInt& VeryLongInt::mulSub(VeryLongInt const &x, VeryLongInt const &y) {
+    if (!isValid() || !x.isValid() || !y.isValid() ||
+        !addProduct(x, y, true))
+        *this = NaN();
     return *this;
 }
 
@@ -192,35 +323,34 @@ tuple<VeryLongInt, VeryLongInt> VeryLongInt::divMod(
         VeryLongInt const &x, VeryLongInt const &y) {
     if (!x.isValid() || !y.isValid() || y == Zero()) {
         return make_tuple(NaN(), NaN());
+    } else if (x < y) {
+        return make_tuple(Zero(), x);
     } else {
-        VeryLongInt remainder = x;
-        VeryLongInt quotient = Zero();
-        const VeryLongInt one = 1;
-        while (remainder >= y) {
-            auto shift = remainder.numberOfBinaryDigits() -
-                         y.numberOfBinaryDigits();
-            VeryLongInt tmp = y << shift;
-            if (tmp > remainder) {
-                tmp >>= 1;
-                --shift;
-            }
-            remainder -= tmp;
-            quotient += (one << shift);
-            remainder = remainder;
-        }
-        return make_tuple(quotient, remainder);
+        /* dzielenie pisemne cyframi, algorytm D Knutha */
+        size_t x_len = x.digits.size(), y_len = y.digits.size();
+        VeryLongInt quotient, remainder;
+        quotient.digits.resize(x_len - y_len + 1);
+        remainder.digits.resize(y_len);
+        SmallVector<Component, 4 * INLINE_DIGITS> scratch(
+            limbs::divScratch(x_len, y_len));
+        limbs::divRem(quotient.digits.data(), remainder.digits.data(),
+                      x.digits.data(), x_len, y.digits.data(), y_len,
+                      scratch.data());
+        quotient.removeLeadingZeros();
+        remainder.removeLeadingZeros();
+        return make_tuple(move(quotient), move(remainder));
     }
 }
 
 VeryLongInt& VeryLongInt::operator/=(VeryLongInt const &x) {
     auto res = divMod(*this, x);
-    *this = get<0>(res);
+    *this = move(get<0>(res));
     return *this;
 }
 
 VeryLongInt& VeryLongInt::operator%=(VeryLongInt const &x) {
     auto res = divMod(*this, x);
-    *this = get<1>(res);
+    *this = move(get<1>(res));
     return *this;
 }
 
@@ -245,20 +375,48 @@ bool operator==(VeryLongInt const &x, VeryLongInt const &y) {
     return x.digits == y.digits;
 }
 
+void VeryLongInt::writeDecimal(char *out, size_t width,
+                               DecimalPowers &powers) const {
+    if (digits.size() <= DECIMAL_THRESHOLD) {
+        /* odcina po CHUNK_DIGITS cyfr od końca */
+        SmallVector<Component, DECIMAL_THRESHOLD> rest;
+        rest.assign(begin(digits), end(digits));
+        size_t len = rest.size();
+        char *end = out + width;
+        while (end > out) {
+            auto chunk = limbs::divRem1(rest.data(), rest.data(), len,
+                                        CHUNK_BASE);
+            while (len > 1 && rest[len - 1] == 0)
+                --len;
+            for (size_t i = 0; i < CHUNK_DIGITS && end > out; ++i) {
+                *--end = '0' + chunk % 10;
+                chunk /= 10;
+            }
+        }
+    } else {
+        /* dzieli przez największą potęgę o mniej niż width zerach */
+        size_t k = 0;
+        while (DecimalPowers::exponent(k + 1) < width)
+            ++k;
+        size_t low = DecimalPowers::exponent(k);
+        auto parts = powers.split(*this, k);
+        get<0>(parts).writeDecimal(out, width - low, powers);
+        get<1>(parts).writeDecimal(out + width - low, low, powers);
+    }
+}
+
 ostream &operator<<(ostream &out, VeryLongInt const &x) {
     if (!x.isValid()) {
         out << "NaN";
     } else if (x == Zero()) {
         out << "0";
     } else {
-        stringstream ss;
-        VeryLongInt y = x;
-        while (y) {
-            ss << (y % 10).getLastDecimalDigit();
-            y /= 10;
-        }
-        string repr = ss.str();
-        reverse(begin(repr), end(repr));
+        /* log10(2) < 0.30103, więc cyfr jest najwyżej tyle */
+        size_t width = x.numberOfBinaryDigits() * 30103 / 100000 + 1;
+        string repr(width, '0');
+        VeryLongInt::DecimalPowers powers;
+        x.writeDecimal(&repr[0], width, powers);
+        repr.erase(0, repr.find_first_not_of('0'));
         out << repr;
     }
     return out;
@@ -285,11 +443,12 @@ VeryLongInt& VeryLongInt::operator<<=(size_t full_shift) {
 
 VeryLongInt& VeryLongInt::operator>>=(size_t full_shift) {
     if (isValid() && full_shift > 0) {
-        auto erase_end = begin(digits) + (full_shift / USED_DIGITS);
-        if (erase_end > digits.end()) {
+        size_t erased = full_shift / USED_DIGITS;
+        /* przesunięcie o całą długość daje zero, nie pusty wektor (NaN) */
+        if (erased >= digits.size()) {
             *this = Zero();
         } else {
-            digits.erase(begin(digits), erase_end);
+            digits.erase(begin(digits), begin(digits) + erased);
             auto digit_shift = full_shift % USED_DIGITS;
             if (digit_shift > 0) {
                 Component carry = 0;
@@ -305,11 +464,6 @@ VeryLongInt& VeryLongInt::operator>>=(size_t full_shift) {
     return *this;
 }
 
-char VeryLongInt::getLastDecimalDigit() const {
-    assert(isValid());
-    return ('0' + digits.front() % 10);
-}
-
 const VeryLongInt& Zero() {
     static VeryLongInt zero = VeryLongInt(0);
     return zero;
@@ -8,6 +8,8 @@
 #include <vector>
 #include <climits>
 #include <tuple>
+#include "limbs.h"
+#include "small_vector.h"
 
 class VeryLongInt;
 
@@ -15,37 +17,50 @@ bool operator!=(VeryLongInt const &x, VeryLongInt const &y);
 bool operator>(VeryLongInt const &x, VeryLongInt const &y);
 bool operator<=(VeryLongInt const &x, VeryLongInt const &y);
 bool operator>=(VeryLongInt const &x, VeryLongInt const &y);
-const VeryLongInt operator+(VeryLongInt x, VeryLongInt const &y);
-const VeryLongInt operator-(VeryLongInt x, VeryLongInt const &y);
-const VeryLongInt operator*(VeryLongInt x, VeryLongInt const &y);
-const VeryLongInt operator/(VeryLongInt x, VeryLongInt const &y);
-const VeryLongInt operator%(VeryLongInt x, VeryLongInt const &y);
-const VeryLongInt operator<<(VeryLongInt x, size_t y);
-const VeryLongInt operator>>(VeryLongInt x, size_t y);
+VeryLongInt operator+(VeryLongInt x, VeryLongInt const &y);
+VeryLongInt operator-(VeryLongInt x, VeryLongInt const &y);
+VeryLongInt operator*(VeryLongInt x, VeryLongInt const &y);
+VeryLongInt operator/(VeryLongInt x, VeryLongInt const &y);
+VeryLongInt operator%(VeryLongInt x, VeryLongInt const &y);
+VeryLongInt operator<<(VeryLongInt x, size_t y);
+VeryLongInt operator>>(VeryLongInt x, size_t y);
 
 class VeryLongInt {
 private:
-    using Component = uint32_t;
+    using Component = limbs::Limb;
+
+    /* Liczba cyfr trzymanych w samym obiekcie: liczby do 128 bitów nie
+     * przydzielają pamięci na stercie */
+    static const size_t INLINE_DIGITS = 128 / limbs::LIMB_BITS;
+    using Digits = SmallVector<Component, INLINE_DIGITS>;
 
     /* Wektor w którym trzymane są kolejne cyfry naszej liczby,
      * w systemie little endian.
      * Zero reprezentowane jako wektor rozmiaru 1, posiada tylko liczbę '0'
      * NaN reprezentowane jako pusty wektor */
-    std::vector<Component> digits;
+    Digits digits;
 
     /* Liczba bitów do zapisu cyfry */
-    const size_t USED_DIGITS = 32;
-    /* Baza systemu liczbowego */
-    const uint64_t BASE = static_cast<uint64_t>(1) << USED_DIGITS;
+    static const size_t USED_DIGITS = limbs::LIMB_BITS;
 
     /* Usuwa zbędne zera z przodu */
     void removeLeadingZeros();
     /* Dodaje na początku wektora shift zer */
     void shiftByComponentsSize(size_t shift);
-    /* Mnoży VeryLongInt przez liczbę typu Component */
-    VeryLongInt multiplyByComponent(Component) const;
-    /* Zwraca cyfrę jakos char */
-    char getLastDecimalDigit() const;
+    /* Wspólna część mulAdd i mulSub. Zwraca false, gdy odejmowanie dało
+     * wynik ujemny */
+    bool addProduct(VeryLongInt const &x, VeryLongInt const &y,
+                    bool subtract);
+    /* Potęgi dziesięciu do dzielenia liczby na części w zapisie
+     * dziesiętnym, obliczane w miarę potrzeby */
+    struct DecimalPowers;
+    /* Zapisuje liczbę dziesiętnie w dokładnie width znakach od out,
+     * dopełniając zerami z przodu. Liczba musi być mniejsza od 10^width */
+    void writeDecimal(char *out, size_t width, DecimalPowers &powers) const;
+    /* Zwraca liczbę zapisaną dziesiętnie w len znakach od s, które muszą
+     * być cyframi */
+    static VeryLongInt readDecimal(char const *s, size_t len,
+                                   DecimalPowers &powers);
     /* Dzieli x / y. Zwraca parę <iloraz, reszta> */
     static std::tuple<VeryLongInt, VeryLongInt> divMod(
         VeryLongInt const &x, VeryLongInt const &y);
@@ -53,10 +68,11 @@ private:
 public:
     VeryLongInt() : VeryLongInt(0) {}
     VeryLongInt(uint64_t num);
-    VeryLongInt(int num) : VeryLongInt(static_cast<uint64_t>(num)) {}
+    /* Liczba ujemna daje NaN, tak jak ujemny wynik odejmowania */
+    VeryLongInt(long long num);
+    VeryLongInt(int num) : VeryLongInt(static_cast<long long>(num)) {}
     VeryLongInt(unsigned num) : VeryLongInt(static_cast<uint64_t>(num)) {}
-    VeryLongInt(long num) : VeryLongInt(static_cast<uint64_t>(num)) {}
-    VeryLongInt(long long num) : VeryLongInt(static_cast<uint64_t>(num)) {}
+    VeryLongInt(long num) : VeryLongInt(static_cast<long long>(num)) {}
     VeryLongInt(unsigned long long num) :
          VeryLongInt(static_cast<uint64_t>(num)) {}
     VeryLongInt(VeryLongInt const &x) : digits(x.digits) {}
@@ -85,6 +101,11 @@ public:
     VeryLongInt& operator<<=(size_t x);
     VeryLongInt& operator>>=(size_t x);
 
+    /* *this += x * y i *this -= x * y bez liczby tymczasowej na iloczyn.
+     * Gdy wynik odejmowania byłby ujemny, *this staje się NaN */
+    VeryLongInt& mulAdd(VeryLongInt const &x, VeryLongInt const &y);
+    VeryLongInt& mulSub(VeryLongInt const &x, VeryLongInt const &y);
+
     VeryLongInt& operator=(VeryLongInt const &x) {
         digits = x.digits;
         return *this;
@@ -115,6 +136,8 @@ public:
     friend bool operator==(VeryLongInt const &x, VeryLongInt const &y);
     friend std::ostream &operator<<(std::ostream &out, VeryLongInt const &x);
     friend const VeryLongInt& NaN();
+    friend class ModularContext;
+    friend class SignedVeryLongInt;
 };
 
 const VeryLongInt& Zero();
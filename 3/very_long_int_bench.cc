@@ -0,0 +1,97 @@
+/* Test wydajności VeryLongInt.
+ *
+ * Dla liczb o kolejnych długościach (w cyfrach dziesiętnych) mierzy średni
+ * czas dodawania, mnożenia, dzielenia, odczytu z napisu i zapisu
+ * dziesiętnego, a także mnożenia modulo y przez ModularContext i przez
+ * (x * x) % y. Potęgowanie modulo, z wykładnikiem o EXPONENT_DIGITS
+ * cyfrach, mierzone jest dla liczb do MAX_POWMOD_DIGITS cyfr. Wyniki
+ * wypisywane są jako wiersze JSON, z szerokością cyfry, z którą zbudowano
+ * program (VERY_LONG_INT_LIMB_BITS), aby można było porównać wersje 32-
+ * i 64-bitową.
+ *
+ * Użycie: very_long_int_bench [długość...] */
+
+#include "very_long_int.h"
+#include "modular.h"
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace std;
+using Clock = chrono::steady_clock;
+
+namespace {
+    /* Łączny czas pomiaru jednej operacji, do którego jest powtarzana */
+    const double MIN_SECONDS = 0.2;
+    const size_t EXPONENT_DIGITS = 100;
+    const size_t MAX_POWMOD_DIGITS = 10000;
+
+    string random_digits(mt19937 &rng, size_t len) {
+        string repr(1, '1' + rng() % 9);
+        while (repr.size() < len)
+            repr += '0' + rng() % 10;
+        return repr;
+    }
+
+    /* Powtarza op, dopóki nie minie MIN_SECONDS, i wypisuje średni czas */
+    template <typename F>
+    void measure(string const &op, size_t digits, F f) {
+        size_t runs = 0;
+        double seconds = 0;
+        auto start = Clock::now();
+        do {
+            f();
+            ++runs;
+            seconds = chrono::duration<double>(Clock::now() - start).count();
+        } while (seconds < MIN_SECONDS);
+        cout << "{\"op\":\"" << op << "\""
+             << ",\"limb_bits\":" << limbs::LIMB_BITS
+             << ",\"digits\":" << digits
+             << ",\"runs\":" << runs
+             << ",\"seconds\":" << seconds / runs << "}\n";
+        cout.flush();
+    }
+}
+
+int main(int argc, char **argv) {
+    vector<size_t> lengths;
+    for (int i = 1; i < argc; ++i)
+        lengths.push_back(strtoull(argv[i], nullptr, 10));
+    if (lengths.empty())
+        lengths = {100, 1000, 10000, 100000};
+
+    mt19937 rng(2015);
+    for (size_t len : lengths) {
+        string xs = random_digits(rng, len), ys = random_digits(rng, len);
+        VeryLongInt x(xs), y(ys), product = x * y, sink;
+
+        measure("add", len, [&]() { sink = x + y; });
+        measure("mul", len, [&]() { sink = x * y; });
+        measure("div", len, [&]() { sink = product / y; });
+        measure("mod", len, [&]() { sink = product % y; });
+        VeryLongInt xr = x % y, e(random_digits(rng, EXPONENT_DIGITS));
+        ModularContext ctx(y);
+        measure("mulmod", len, [&]() { sink = ctx.mulMod(xr, xr); });
+        measure("mulmod_divide", len, [&]() { sink = xr * xr % y; });
+        if (!(sink == ctx.mulMod(xr, xr))) {
+            cerr << "wrong modular product for " << len << " digits\n";
+            return 1;
+        }
+        if (len <= MAX_POWMOD_DIGITS)
+            measure("powmod", len, [&]() { sink = ctx.powMod(x, e); });
+        measure("parse", len, [&]() { sink = VeryLongInt(xs); });
+        measure("print", len, [&]() {
+            stringstream s;
+            s << x;
+        });
+        if (!(product / y == x) || !(sink == x)) {
+            cerr << "wrong result for " << len << " digits\n";
+            return 1;
+        }
+    }
+    return 0;
+}